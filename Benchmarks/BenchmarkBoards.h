@@ -0,0 +1,60 @@
+// Boards and timing shared by the benchmarks: the recorded boards, the
+// seeded word-rich boards, and the letter mix random boards are drawn from
+// Included after ../FinalWordHuntSolver.cpp, whose solver it uses
+
+#include <random>
+
+using namespace std;
+
+// Letters by English frequency: drawing one uniformly gives a letter as
+// often as it appears in English text
+const string englishLetters = "EEEEEEEEEEEEAAAAAAAAAIIIIIIIIIOOOOOOOONNNNNNRRRRRRTTTTTTLLLLSSSSUUUUDDDDGGGBBCCMMPPFFHHVVWWYYKJXQZ";
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Boards recorded in Logs/results.txt ("Board: <16 letters>")
+vector<string> recordedBoards() {
+    vector<string> boards;
+    ifstream log("Logs/results.txt");
+    string line;
+    while(getline(log, line)) {
+        if (line.rfind("Board: ", 0) != 0) continue;
+        string b = line.substr(7);
+        while(!b.empty() && isspace(b.back())) b.pop_back();
+        if (b.size() != 16 || !all_of(b.begin(), b.end(), ::isalpha)) continue;
+        for(char &c : b) c = toupper(c);
+        boards.push_back(b);
+    }
+    return boards;
+}
+
+// count word-rich 4x4 boards: each starts as a seeded random board (letters
+// drawn from englishLetters) and keeps any single-letter change that does
+// not lose words, for steps changes
+vector<string> denseBoards(int count, int steps = 3000, unsigned seed = 12345) {
+    mt19937 rng(seed);
+    Solver s;
+    s.trie = &trie;
+    auto countWords = [&](const string &b) {
+        setBoard(s, b);
+        searchWords(s);
+        return s.words.size();
+    };
+
+    vector<string> boards;
+    for(int i = 0; i < count; i++) {
+        string b(16, 'A');
+        for(char &c : b) c = englishLetters[rng() % englishLetters.size()];
+        size_t best = countWords(b);
+        for(int j = 0; j < steps; j++) {
+            string next = b;
+            next[rng() % next.size()] = englishLetters[rng() % englishLetters.size()];
+            size_t found = countWords(next);
+            if (found >= best) b = next, best = found;
+        }
+        boards.push_back(b);
+    }
+    return boards;
+}
@@ -0,0 +1,299 @@
+/**
+ * Benchmark suite for FinalWordHuntSolver
+ *
+ * Solves a fixed corpus of boards and reports the latency distribution of
+ * each phase of a solve, the words per board and the dictionary load time,
+ * next to the two solvers in "Old Solvers/" on the 4x4 boards they handle.
+ * The corpus is the boards recorded in Logs/results.txt plus seeded boards,
+ * so every run solves the same boards and runs can be compared:
+ * - 4x4 and 5x5 boards with letters drawn by English frequency
+ * - adversarial boards: word-rich 4x4 boards (random boards improved one
+ *   letter at a time) and 5x5 boards from six common letters, where the
+ *   dfs has the most paths to walk
+ *
+ * Usage (from the repository root, so the relative dictionary path resolves):
+ * g++ -O2 -pthread Benchmarks/BenchmarkSuite.cpp -o BenchmarkSuite
+ * ./BenchmarkSuite [passes=3] [results.json]
+ *
+ * Each board is solved passes times and its fastest pass counts. With a file
+ * name, the numbers are also written there as JSON.
+ */
+
+#define WORDHUNT_NO_MAIN
+#include "../FinalWordHuntSolver.cpp"
+#include "BenchmarkBoards.h"
+
+#include <climits>
+#include <iomanip>
+#include <sstream>
+#include <unordered_set>
+
+// The old solvers, each in its own namespace; their standard headers are
+// already included above, so only their code lands in the namespace. Their
+// main()s end without a return, which is only allowed of the global one.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+namespace basic {
+#include "../Old Solvers/BasicWordHuntSolver.cpp"
+}
+namespace advanced {
+#include "../Old Solvers/AdvancedWordHuntSolver.cpp"
+}
+#pragma GCC diagnostic pop
+
+/*
+Corpus
+*/
+struct Corpus {
+    string name;
+    vector<string> boards;
+    bool square4; // every board is 4x4, so the old solvers can run it
+};
+
+// count seeded side x side boards drawn from letters
+vector<string> seededBoards(const string &letters, int side, int count, unsigned seed) {
+    mt19937 rng(seed);
+    vector<string> boards;
+    for(int i = 0; i < count; i++) {
+        string b(side * side, 'A');
+        for(char &c : b) c = letters[rng() % letters.size()];
+        boards.push_back(b);
+    }
+    return boards;
+}
+
+// FNV-1a over the corpus, so two runs can be checked to have solved the same boards
+uint32_t corpusChecksum(const vector<string> &boards) {
+    uint32_t h = 2166136261u;
+    for(const string &b : boards) {
+        for(char c : b) h = (h ^ (unsigned char) c) * 16777619u;
+        h = (h ^ '\n') * 16777619u;
+    }
+    return h;
+}
+
+/*
+Timing
+Each solve is split into its phases. A board's time in a phase is its
+fastest over the passes; the distribution is over the boards.
+*/
+struct PhaseTimes {
+    string name;
+    vector<double> seconds; // per board
+};
+
+struct LatencySummary {
+    double p50, p90, p99, max;
+};
+
+LatencySummary summarize(vector<double> v) {
+    if (v.empty()) return {0, 0, 0, 0};
+    sort(v.begin(), v.end());
+    auto at = [&](double p) { return v[min(v.size() - 1, (size_t) (p * v.size()))] * 1e6; };
+    return {at(0.50), at(0.90), at(0.99), v.back() * 1e6};
+}
+
+// Runs solve(board, phase seconds) passes times per board and keeps each
+// board's fastest time in each phase; returns the words found per board
+vector<size_t> timePhases(const vector<string> &boards, int passes, vector<PhaseTimes> &phases,
+                          const function<size_t(const string&, vector<double>&)> &solve) {
+    vector<size_t> found(boards.size());
+    for(PhaseTimes &p : phases) p.seconds.assign(boards.size(), 1e9);
+    vector<double> t(phases.size());
+    for(int pass = 0; pass < passes; pass++) {
+        for(int i = 0; i < boards.size(); i++) {
+            fill(t.begin(), t.end(), 0);
+            found[i] = solve(boards[i], t);
+            for(int k = 0; k < phases.size(); k++) phases[k].seconds[i] = min(phases[k].seconds[i], t[k]);
+        }
+    }
+    return found;
+}
+
+// Times f, adding its seconds to into
+template<class F>
+auto timed(double &into, F f) {
+    auto start = chrono::steady_clock::now();
+    auto result = f();
+    into += secondsSince(start);
+    return result;
+}
+
+/*
+The solvers
+*/
+Solver suiteSolver;
+
+size_t solveCurrent(const string &b, vector<double> &t) {
+    Solver &s = suiteSolver;
+    string record;
+    timed(t[0], [&]() { setBoard(s, b); clearWords(s); return 0; });
+    timed(t[1], [&]() { searchWords(s); return 0; });
+    timed(t[2], [&]() { chooseWords(s); return 0; });
+    timed(t[3], [&]() { orderOptimally(s); return 0; });
+    timed(t[4], [&]() {
+        BoardResult r;
+        r.board = b;
+        r.words.swap(s.words);
+        r.chosen.swap(s.filteredWords);
+        appendResult(record, r);
+        s.words.swap(r.words);
+        return 0;
+    });
+    for(int k = 0; k < 5; k++) t[5] += t[k];
+    return s.words.size();
+}
+
+// The old solvers leave a new node's word flag uninitialized (they only set
+// it on the nodes that end a word); this clears every flag under node
+template<class Node>
+void clearWordFlags(Node &node) {
+    node.word = false;
+    for(auto &child : node.children) clearWordFlags(*child.second);
+}
+
+// The old solvers clear a word's flag in their trie once they find it;
+// this sets the flags back (for the next board, or after clearWordFlags)
+template<class Node>
+void restoreWords(Node &root, const vector<string> &words) {
+    for(const string &w : words) {
+        Node *curr = &root;
+        for(char l : w) curr = curr->children[l];
+        curr->word = true;
+    }
+}
+
+template<class Board>
+void setOldBoard(Board &board, const string &b) {
+    board.assign(4, vector<char>());
+    for(int i = 0; i < 16; i++) board[i / 4].push_back(toupper(b[i]));
+}
+
+size_t solveBasic(const string &b, vector<double> &t) {
+    setOldBoard(basic::board, b);
+    basic::words.clear();
+    basic::filteredWords.clear();
+    timed(t[0], [&]() { basic::searchWords(); return 0; });
+    timed(t[1], [&]() { basic::filterByLength(); return 0; });
+    t[2] = t[0] + t[1];
+    restoreWords(basic::root, basic::words);
+    return basic::words.size();
+}
+
+size_t solveAdvanced(const string &b, vector<double> &t) {
+    setOldBoard(advanced::board, b);
+    advanced::words.clear();
+    advanced::filteredWords.clear();
+    timed(t[0], [&]() { advanced::searchWords(); return 0; });
+    vector<string> found;
+    for(auto &entry : advanced::words) found.push_back(entry.first);
+    // Its selection loops forever on a board with no words
+    if (!found.empty()) timed(t[1], [&]() { advanced::filterByComplexity(); return 0; });
+    t[2] = t[0] + t[1];
+    restoreWords(advanced::root, found);
+    return found.size();
+}
+
+/*
+Report
+*/
+ostringstream json;
+
+void reportPhases(const string &solver, const vector<PhaseTimes> &phases, const vector<size_t> &found, bool last) {
+    double words = 0;
+    size_t most = 0;
+    for(size_t n : found) words += n, most = max(most, n);
+    words /= max((size_t) 1, found.size());
+
+    cout << "  " << solver << ": " << words << " words/board (max " << most << ")\n";
+    json << "\"" << solver << "\":{\"wordsPerBoard\":" << words << ",\"maxWords\":" << most << ",\"phases\":{";
+    for(int k = 0; k < phases.size(); k++) {
+        LatencySummary l = summarize(phases[k].seconds);
+        cout << "    " << left << setw(16) << phases[k].name << right << setw(10) << l.p50 << setw(10) << l.p90
+             << setw(10) << l.p99 << setw(10) << l.max << '\n';
+        json << (k > 0 ? "," : "") << "\"" << phases[k].name << "\":{\"p50Us\":" << l.p50 << ",\"p90Us\":" << l.p90
+             << ",\"p99Us\":" << l.p99 << ",\"maxUs\":" << l.max << "}";
+    }
+    json << "}}" << (last ? "" : ",");
+}
+
+void runCorpus(const Corpus &c, int passes, bool last) {
+    cout << c.name << ": " << c.boards.size() << " boards, checksum " << hex << corpusChecksum(c.boards) << dec << '\n';
+    cout << "    " << left << setw(16) << "phase (us)" << right << setw(10) << "p50" << setw(10) << "p90"
+         << setw(10) << "p99" << setw(10) << "max" << '\n';
+    json << "\"" << c.name << "\":{\"boards\":" << c.boards.size() << ",\"checksum\":" << corpusChecksum(c.boards) << ",";
+
+    vector<PhaseTimes> phases = {{"setBoard"}, {"searchWords"}, {"chooseWords"}, {"orderOptimally"}, {"appendResult"}, {"total"}};
+    vector<size_t> found = timePhases(c.boards, passes, phases, solveCurrent);
+    reportPhases("FinalWordHuntSolver", phases, found, !c.square4);
+    if (c.square4) {
+        vector<PhaseTimes> old = {{"searchWords"}, {"filterByLength"}, {"total"}};
+        found = timePhases(c.boards, passes, old, solveBasic);
+        reportPhases("BasicWordHuntSolver", old, found, false);
+        old = {{"searchWords"}, {"filterByComplexity"}, {"total"}};
+        found = timePhases(c.boards, passes, old, solveAdvanced);
+        reportPhases("AdvancedWordHuntSolver", old, found, true);
+    }
+    json << "}" << (last ? "" : ",");
+}
+
+int main(int argc, char **argv) {
+    int passes = argc > 1 ? max(1, atoi(argv[1])) : 3;
+    string jsonPath = argc > 2 ? argv[2] : "";
+    cout << fixed << setprecision(1);
+
+    // Dictionary load: the old solvers' map tries (they read ../InputOutput,
+    // so their streams are pointed at the dictionary from here), then the
+    // way the solver starts, and from text for comparison
+    basic::fin.close();
+    basic::fin.open(dictionaryTextPath);
+    auto start = chrono::steady_clock::now();
+    basic::construct_trie();
+    double basicLoad = secondsSince(start) * 1000;
+    advanced::fin.close();
+    advanced::fin.open(dictionaryTextPath);
+    start = chrono::steady_clock::now();
+    advanced::construct_trie();
+    double advancedLoad = secondsSince(start) * 1000;
+    start = chrono::steady_clock::now();
+    if (!construct_trie()) return 1;
+    double load = secondsSince(start) * 1000;
+    ifstream in(dictionaryTextPath);
+    start = chrono::steady_clock::now();
+    Trie fromText = buildDictionary(readWords(in));
+    double textLoad = secondsSince(start) * 1000;
+    // Only the nodes that end a word had their flag set, so every flag is
+    // cleared and the dictionary's words set again
+    vector<string> dictionaryWords;
+    ifstream dictionaryFile(dictionaryTextPath);
+    for(string w; dictionaryFile >> w;) dictionaryWords.push_back(w);
+    clearWordFlags(basic::root);
+    restoreWords(basic::root, dictionaryWords);
+    clearWordFlags(advanced::root);
+    restoreWords(advanced::root, dictionaryWords);
+
+    cout << "dictionary load (ms): FinalWordHuntSolver " << load << " (from text " << textLoad << "), BasicWordHuntSolver "
+         << basicLoad << ", AdvancedWordHuntSolver " << advancedLoad << "\n\n";
+    json << "{\"passes\":" << passes << ",\"dictionaryLoadMs\":{\"FinalWordHuntSolver\":" << load << ",\"fromText\":" << textLoad
+         << ",\"BasicWordHuntSolver\":" << basicLoad << ",\"AdvancedWordHuntSolver\":" << advancedLoad << "},\"corpora\":{";
+
+    suiteSolver.trie = &trie;
+    reverseIndexOf(trie); // built once, not part of any board's time
+    vector<Corpus> corpora = {
+        {"recorded 4x4", recordedBoards(), true},
+        {"seeded 4x4", seededBoards(englishLetters, 4, 200, 4), true},
+        {"seeded 5x5", seededBoards(englishLetters, 5, 100, 5), false},
+        {"dense 4x4", denseBoards(20, 2000, 16), true},
+        {"5x5 from 6 letters", seededBoards("AEINST", 5, 50, 6), false},
+    };
+    for(int i = 0; i < corpora.size(); i++) {
+        runCorpus(corpora[i], passes, i + 1 == corpora.size());
+        cout << '\n';
+    }
+    json << "}}\n";
+
+    if (!jsonPath.empty()) {
+        ofstream out(jsonPath);
+        out << json.str();
+    }
+}
@@ -0,0 +1,171 @@
+/**
+ * Load generator for FinalWordHuntSolver's server mode (--serve)
+ *
+ * Opens several connections to a running server and keeps a number of
+ * requests in flight on each (pipelining), then reports latency percentiles
+ * and requests per second. Boards come from a file, one per line (the last
+ * token, so Logs/results.txt works as is), and are sent round-robin.
+ *
+ * Usage (from the repository root):
+ * g++ -O2 -pthread Benchmarks/LoadGenerator.cpp -o LoadGenerator
+ * ./FinalWordHuntSolver --serve /tmp/wordhunt.sock --threads &
+ * ./LoadGenerator /tmp/wordhunt.sock [connections] [requests per connection] [pipeline depth] [boards file]
+ *
+ * The address is a Unix socket path or a localhost TCP port, as for --serve.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+typedef chrono::steady_clock::time_point TimePoint;
+
+// Connects to a server address (port number or Unix socket path), -1 on failure
+int connectTo(const string &address) {
+    bool tcp = !address.empty() && address.find_first_not_of("0123456789") == string::npos;
+    int fd = socket(tcp ? AF_INET : AF_UNIX, SOCK_STREAM, 0);
+    int connected = -1;
+    if (fd != -1 && tcp) {
+        sockaddr_in a = {};
+        a.sin_family = AF_INET;
+        a.sin_port = htons(atoi(address.c_str()));
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        connected = connect(fd, (sockaddr*) &a, sizeof(a));
+    }
+    else if (fd != -1 && address.size() < sizeof(sockaddr_un::sun_path)) {
+        sockaddr_un a = {};
+        a.sun_family = AF_UNIX;
+        strcpy(a.sun_path, address.c_str());
+        connected = connect(fd, (sockaddr*) &a, sizeof(a));
+    }
+    if (connected == -1) {
+        if (fd != -1) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Boards from a file, one per line (the line's last token). If some lines
+// start with "Board:", as in Logs/results.txt, only the ones that end in
+// a square number of letters are boards (one of them is "forgot to record").
+vector<string> readBoards(const string &path) {
+    ifstream in(path);
+    vector<string> boards, recorded;
+    string line;
+    while(getline(in, line)) {
+        size_t end = line.find_last_not_of(" \t\r");
+        if (end == string::npos) continue;
+        size_t begin = line.find_last_of(" \t", end);
+        begin = (begin == string::npos) ? 0 : begin + 1;
+        boards.push_back(line.substr(begin, end + 1 - begin));
+        const string &b = boards.back();
+        int side = sqrt(b.size());
+        if (line.compare(0, 6, "Board:") == 0 && side * side == (int) b.size() && all_of(b.begin(), b.end(), ::isalpha)) {
+            recorded.push_back(b);
+        }
+    }
+    return recorded.empty() ? boards : recorded;
+}
+
+struct ConnectionStats {
+    vector<double> latencies; // seconds, one per response
+    long long errors = 0; // responses with an "error" field
+    bool failed = false; // the connection broke before every response came back
+};
+
+// Sends requests boards on one connection, keeping up to depth of them
+// unanswered, and times each one from send to response
+void drive(const string &address, const vector<string> &boards, int offset, int requests, int depth, ConnectionStats &stats) {
+    int fd = connectTo(address);
+    if (fd == -1) {
+        stats.failed = true;
+        return;
+    }
+    vector<TimePoint> sent(requests);
+    int nextSend = 0, nextReceive = 0;
+    string in;
+    char buffer[65536];
+
+    while(nextReceive < requests) {
+        // Top up the pipeline in one write
+        string batch;
+        while(nextSend < requests && nextSend - nextReceive < depth) {
+            batch += boards[(offset + nextSend) % boards.size()] + '\n';
+            sent[nextSend++] = chrono::steady_clock::now();
+        }
+        if (!batch.empty() && send(fd, batch.data(), batch.size(), MSG_NOSIGNAL) != (ssize_t) batch.size()) break;
+
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) break;
+        TimePoint now = chrono::steady_clock::now();
+        in.append(buffer, n);
+        size_t begin = 0, end;
+        while((end = in.find('\n', begin)) != string::npos) {
+            if (in.find("\"error\":", begin) < end) stats.errors++;
+            stats.latencies.push_back(chrono::duration<double>(now - sent[nextReceive++]).count());
+            begin = end + 1;
+        }
+        in.erase(0, begin);
+    }
+    stats.failed = nextReceive < requests;
+    close(fd);
+}
+
+double percentile(const vector<double> &sorted, double p) {
+    if (sorted.empty()) return 0;
+    return sorted[min(sorted.size() - 1, (size_t) (p * sorted.size()))];
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        cout << "usage: LoadGenerator address [connections] [requests per connection] [pipeline depth] [boards file]" << endl;
+        return 1;
+    }
+    string address = argv[1];
+    int connections = argc > 2 ? atoi(argv[2]) : 4;
+    int requests = argc > 3 ? atoi(argv[3]) : 1000;
+    int depth = argc > 4 ? atoi(argv[4]) : 8;
+    vector<string> boards = readBoards(argc > 5 ? argv[5] : "Logs/results.txt");
+    if (boards.empty() || connections <= 0 || requests <= 0 || depth <= 0) {
+        cerr << "need boards and positive counts" << endl;
+        return 1;
+    }
+
+    vector<ConnectionStats> stats(connections);
+    vector<thread> clients;
+    TimePoint start = chrono::steady_clock::now();
+    for(int i = 0; i < connections; i++) {
+        clients.emplace_back(drive, cref(address), cref(boards), i * requests, requests, depth, ref(stats[i]));
+    }
+    for(thread &t : clients) t.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<double> latencies;
+    long long errors = 0, failed = 0;
+    for(const ConnectionStats &s : stats) {
+        latencies.insert(latencies.end(), s.latencies.begin(), s.latencies.end());
+        errors += s.errors;
+        failed += s.failed;
+    }
+    sort(latencies.begin(), latencies.end());
+
+    cout << connections << " connection(s) x " << requests << " requests, pipeline depth " << depth << '\n';
+    cout << latencies.size() << " responses in " << seconds << " s: " << latencies.size() / seconds << " requests/s\n";
+    cout << "latency: p50 " << percentile(latencies, 0.50) * 1000 << " ms, p99 " << percentile(latencies, 0.99) * 1000
+         << " ms, max " << (latencies.empty() ? 0 : latencies.back() * 1000) << " ms\n";
+    if (errors) cout << errors << " error response(s)\n";
+    if (failed) cout << failed << " connection(s) failed\n";
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,1078 @@
+/**
+ * Benchmarks for FinalWordHuntSolver
+ *
+ * Includes the solver as a library (its main() is compiled out) and times
+ * its pieces against the recorded boards in Logs/results.txt.
+ *
+ * Usage (from the repository root, so the relative dictionary path resolves):
+ * g++ -O2 -pthread Benchmarks/SolverBenchmark.cpp -o SolverBenchmark
+ * ./SolverBenchmark trie
+ */
+
+#define WORDHUNT_NO_MAIN
+#include "../FinalWordHuntSolver.cpp"
+#include "BenchmarkBoards.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <malloc.h>
+#include <new>
+#include <random>
+#include <sstream>
+
+/*
+Allocation tracking
+Every heap allocation in the process goes through these, so a benchmark can
+read how many bytes are live and how many allocations it made
+*/
+long long liveBytes = 0;
+long long allocCount = 0;
+
+void* operator new(size_t size) {
+    void *p = malloc(size);
+    if (!p) throw bad_alloc();
+    liveBytes += malloc_usable_size(p);
+    allocCount++;
+    return p;
+}
+void operator delete(void *p) noexcept {
+    if (p) liveBytes -= malloc_usable_size(p);
+    free(p);
+}
+void operator delete(void *p, size_t) noexcept {
+    operator delete(p);
+}
+
+/*
+Helpers
+*/
+const int N = 4; // the recorded boards are 4x4
+
+// A solver on the shared dictionary, for the benchmarks that solve one board at a time
+Solver bench;
+
+// Runs f repeatedly for at least minSeconds, returns {iterations, seconds}
+pair<long long,double> timeLoop(const function<void()> &f, double minSeconds = 1.0) {
+    long long iterations = 0;
+    auto start = chrono::steady_clock::now();
+    do {
+        f();
+        iterations++;
+    } while(secondsSince(start) < minSeconds);
+    return {iterations, secondsSince(start)};
+}
+
+/*
+trie: memory footprint and trie walk speed of the map-based trie
+(the original TrieNode) against the compact array trie
+*/
+struct LegacyTrieNode {
+    map<char, LegacyTrieNode*> children;
+    bool isWord;
+};
+
+LegacyTrieNode* buildLegacyTrie(const vector<string> &ws) {
+    LegacyTrieNode *root = new LegacyTrieNode();
+    for(const string &w : ws) {
+        LegacyTrieNode *curr = root;
+        for(char l : w) {
+            if (curr->children.find(l) == curr->children.end()) {
+                curr->children[l] = new LegacyTrieNode();
+            }
+            curr = curr->children[l];
+        }
+        curr->isWord = true;
+    }
+    return root;
+}
+
+// Walks every board path that stays inside the trie and counts the nodes visited.
+// Node is a LegacyTrieNode* or a compact trie index; step returns the child or missing.
+template<class Node, class Step>
+long long walkBoard(const string &b, int cell, int visited, Node curr, Node missing, Step step) {
+    long long count = 1;
+    int r = cell / N, c = cell % N;
+    for(pair<int,int> d : directions) {
+        int nr = r + d.first, nc = c + d.second;
+        if (nr < 0 || nr >= N || nc < 0 || nc >= N) continue;
+        int next = nr * N + nc;
+        if (visited & (1 << next)) continue;
+        Node child = step(curr, b[next]);
+        if (child == missing) continue;
+        count += walkBoard(b, next, visited | (1 << next), child, missing, step);
+    }
+    return count;
+}
+
+template<class Node, class Step>
+long long walkBoards(const vector<string> &boards, Node root, Node missing, Step step) {
+    long long count = 0;
+    for(const string &b : boards) {
+        for(int cell = 0; cell < N*N; cell++) {
+            Node start = step(root, b[cell]);
+            if (start != missing) count += walkBoard(b, cell, 1 << cell, start, missing, step);
+        }
+    }
+    return count;
+}
+
+void benchTrie(const vector<string> &boards) {
+    ifstream in("InputOutput/dictionary.txt");
+    vector<string> ws = readWords(in);
+
+    long long before = liveBytes, allocsBefore = allocCount;
+    auto start = chrono::steady_clock::now();
+    LegacyTrieNode *legacy = buildLegacyTrie(ws);
+    double legacyBuild = secondsSince(start);
+    long long legacyBytes = liveBytes - before, legacyAllocs = allocCount - allocsBefore;
+
+    before = liveBytes, allocsBefore = allocCount;
+    start = chrono::steady_clock::now();
+    Trie compact = buildTrie(ws);
+    double compactBuild = secondsSince(start);
+    long long compactBytes = liveBytes - before, compactAllocs = allocCount - allocsBefore;
+
+    auto legacyStep = [](LegacyTrieNode *n, char l) {
+        auto it = n->children.find(l);
+        return it == n->children.end() ? nullptr : it->second;
+    };
+    auto compactStep = [&compact](int n, char l) {
+        return trieChild(compact, n, l);
+    };
+
+    long long legacyNodes = 0, compactNodes = 0;
+    auto legacyTime = timeLoop([&]() { legacyNodes += walkBoards(boards, legacy, (LegacyTrieNode*)nullptr, legacyStep); });
+    auto compactTime = timeLoop([&]() { compactNodes += walkBoards(boards, 0, -1, compactStep); });
+
+    cout << "words: " << ws.size() << ", boards: " << boards.size() << '\n';
+    cout << "map trie:     " << legacyBytes / 1024 << " KiB in " << legacyAllocs << " allocations, built in "
+         << legacyBuild * 1000 << " ms, " << legacyNodes / legacyTime.second / 1e6 << " M nodes visited/s\n";
+    cout << "compact trie: " << compactBytes / 1024 << " KiB in " << compactAllocs << " allocations ("
+         << compact.nodeCount << " nodes), built in " << compactBuild * 1000 << " ms, "
+         << compactNodes / compactTime.second / 1e6 << " M nodes visited/s\n";
+}
+
+/*
+dictionary: startup cost of parsing dictionary.txt against mapping a
+compiled dictionary image
+*/
+void benchDictionary() {
+    const string imagePath = "/tmp/wordhunt_bench_dictionary.bin";
+    double textSeconds = 0, imageSeconds = 0;
+    int runs = 5;
+
+    for(int i = 0; i < runs; i++) {
+        auto start = chrono::steady_clock::now();
+        ifstream in(dictionaryTextPath);
+        Trie t = buildDictionary(readWords(in));
+        textSeconds += secondsSince(start);
+        if (i == 0) writeDictionaryImage(t, imagePath, dictionaryTextPath);
+    }
+    for(int i = 0; i < runs; i++) {
+        auto start = chrono::steady_clock::now();
+        Trie t;
+        if (!loadDictionaryImage(t, imagePath, dictionaryTextPath)) return;
+        imageSeconds += secondsSince(start);
+    }
+    remove(imagePath.c_str());
+
+    cout << "parse dictionary.txt: " << textSeconds / runs * 1000 << " ms\n";
+    cout << "map dictionary image: " << imageSeconds / runs * 1000 << " ms\n";
+}
+
+/*
+search: boards/sec and allocations/board of the original search core (word
+copied by value on every call, linear scan of the path for repeats) against
+the bitboard core (in-place path stack, visited bitmask, moves picked from
+the trie node's child letters)
+*/
+bool legacyInBounds(const letter &l, const pair<int,int> &offset) {
+    int x = l.row + offset.first; int y = l.col + offset.second;
+    return 0 <= x && x < N && 0 <= y && y < N;
+}
+
+bool legacyNotRepeated(const letter &l, const word &w) {
+    for(letter used : w.path) {
+        if (l == used) return false;
+    }
+    return true;
+}
+
+pair<int,int> legacyRepeats(const letter &l, const word &w) {
+    letter lastLetter = w.path[w.path.size() - 1];
+    int repeats = 0;
+    int lRepeatNum = 0;
+    for(pair<int,int> change : directions) {
+        if (!legacyInBounds(lastLetter, change)) continue;
+
+        letter n;
+        n.row = lastLetter.row + change.first;
+        n.col = lastLetter.col + change.second;
+
+        if (l.row == n.row && l.col == n.col) lRepeatNum = repeats;
+        else if (bench.board[n.row][n.col] == l.l && legacyNotRepeated(n, w)) repeats++;
+    }
+    return make_pair(repeats, lRepeatNum);
+}
+
+SearchContext legacySearch; // only its duplicate suppression is used
+
+void legacyDfs(word w, int curr, uint32_t id) {
+    if (w.path.size() >= 3 && (trie.nodes[curr].mask & isWordBit) && legacySearch.foundEpoch[id] != legacySearch.epoch) {
+        bench.words.push_back(w);
+        legacySearch.foundEpoch[id] = legacySearch.epoch;
+    }
+    letter last = w.path[w.path.size() - 1];
+
+    for (pair<int,int> offset : directions) {
+        if (!legacyInBounds(last, offset)) continue;
+
+        int r = last.row + offset.first; int c = last.col + offset.second;
+        letter l = {bench.board[r][c], r, c, false, 0};
+
+        if (legacyNotRepeated(l, w) && trieChild(trie, curr, l.l) != -1) {
+            l.isDiag = (l.row - last.row) != 0 && (l.col - last.col) != 0;
+            tie(l.repeat, l.repeatNum) = legacyRepeats(l, w);
+            int cChange = l.isDiag * diagComplexity + l.repeat * repeatComplexity;
+
+            w.path.push_back(l);
+            w.complexity += cChange;
+            int child = trieChild(trie, curr, l.l);
+            legacyDfs(w, child, id + trie.nodes[child].wordsBefore);
+            w.path.pop_back();
+            w.complexity -= cChange;
+        }
+    }
+}
+
+void legacySearchWords() {
+    legacySearch.trie = &trie;
+    newSearchEpoch(legacySearch);
+    for(int r = 0; r < N; r++) {
+        for(int c = 0; c < N; c++) {
+            word w = {vector<letter>(), baseComplexity, 0, false};
+            letter l = {bench.board[r][c], r, c, false, 0};
+            int start = trieChild(trie, 0, l.l);
+            if (start == -1) continue;
+
+            w.path.push_back(l);
+            legacyDfs(w, start, trie.nodes[start].wordsBefore);
+        }
+    }
+}
+
+void benchSearch(const vector<string> &boards) {
+    construct_trie();
+    bench.trie = &trie;
+    searchEngine = forwardEngine;
+
+    auto run = [&](const char *name, const function<void()> &searchCore) {
+        long long solved = 0, allocs = 0, found = 0;
+        double seconds = 0;
+        while(seconds < 1.0) {
+            for(const string &b : boards) {
+                setBoard(bench, b);
+                bench.words.clear();
+                bench.words.shrink_to_fit();
+
+                long long allocsBefore = allocCount;
+                auto start = chrono::steady_clock::now();
+                searchCore();
+                seconds += secondsSince(start);
+                allocs += allocCount - allocsBefore;
+                found += bench.words.size();
+                solved++;
+            }
+        }
+        cout << name << solved / seconds << " boards/s, " << (double) allocs / solved
+             << " allocations/board (" << (double) found / solved << " words/board)\n";
+    };
+    run("old core: ", legacySearchWords);
+    run("new core: ", []() { searchWords(bench); });
+}
+
+/*
+threads: boards/sec of the search with 1 thread up to every core,
+against the serial search
+*/
+double searchBoardsPerSecond(const vector<string> &boards) {
+    long long solved = 0;
+    double seconds = 0;
+    while(seconds < 1.0) {
+        for(const string &b : boards) {
+            setBoard(bench, b);
+            auto start = chrono::steady_clock::now();
+            searchWords(bench);
+            seconds += secondsSince(start);
+            solved++;
+        }
+    }
+    return solved / seconds;
+}
+
+void benchThreads(const vector<string> &boards) {
+    construct_trie();
+    bench.trie = &trie;
+    int cores = max(1u, thread::hardware_concurrency());
+    searchEngine = forwardEngine;
+
+    bench.pool = nullptr;
+    double serial = searchBoardsPerSecond(boards);
+    cout << "serial:     " << serial << " boards/s\n";
+
+    for(int t = 1; t <= cores; t = (t * 2 > cores && t < cores) ? cores : t * 2) {
+        ThreadPool pool(t);
+        bench.pool = &pool;
+        double parallel = searchBoardsPerSecond(boards);
+        cout << t << " thread(s): " << parallel << " boards/s (" << parallel / serial << "x serial)\n";
+        bench.pool = nullptr;
+    }
+}
+
+/*
+batch: full solves/sec of batch mode with 1 solver thread up to every core,
+each solver working through its own share of the boards
+*/
+void benchBatch(const vector<string> &boards) {
+    construct_trie();
+    int cores = max(1u, thread::hardware_concurrency());
+    const int rounds = 20;
+    double single = 0;
+
+    for(int t = 1; t <= cores; t = (t * 2 > cores && t < cores) ? cores : t * 2) {
+        stringstream in, out;
+        for(int i = 0; i < rounds; i++) {
+            for(const string &b : boards) in << b << '\n';
+        }
+        auto start = chrono::steady_clock::now();
+        runBatch(in, out, t);
+        double perSecond = rounds * boards.size() / secondsSince(start);
+        if (t == 1) single = perSecond;
+        cout << t << " solver thread(s): " << perSecond << " boards/s (" << perSecond / single << "x one solver)\n";
+    }
+}
+
+/*
+select: selections/sec and allocations/selection of the original greedy
+selection and ordering (linear scan for the best ratio on every pick, every
+word compared against each pick, chosen words copied and matched by path)
+against the ratio heap, prefix tree and index lists, on word-rich boards;
+both must choose the same words
+*/
+word* legacyFindBestRatio(Solver &s) {
+    word* best = nullptr;
+    double currRatio = 0;
+
+    for(int i = 0; i < s.words.size(); i++) {
+        word *w = &s.words[i];
+        if ((*w).chosen) continue;
+        double ratio = (double) calculateReward(*w) / ((*w).complexity - (*w).complexityUpdate);
+
+        if (ratio > currRatio) {
+            currRatio = ratio;
+            best = w;
+        }
+    }
+    return best;
+}
+
+void legacyUpdateComplexities(Solver &s, word &w) {
+    for(int i = 0; i < s.words.size(); i++) {
+        word *w2 = &s.words[i];
+        auto worth = similarityWorth.find(findSimilarity(*w2, w));
+        int update = worth == similarityWorth.end() ? 0 : worth->second;
+
+        update = max(update, (*w2).complexityUpdate);
+        if ((*w2).complexity - update <= 0) update = (*w2).complexity - 1;
+        (*w2).complexityUpdate = update;
+    }
+}
+
+void legacyChooseWords(Solver &s) {
+    int complexityLeft = complexityBound;
+
+    while(complexityLeft > 0) {
+        word* w = legacyFindBestRatio(s);
+        if (!w) break;
+
+        (*w).chosen = true;
+        complexityLeft -= ((*w).complexity - (*w).complexityUpdate);
+        s.chosenWords.push_back(w - &s.words[0]);
+        legacyUpdateComplexities(s, *w);
+    }
+}
+
+void legacyOrderOptimally(Solver &s, vector<word> &filteredWords) {
+    vector<word> chosenWords;
+    for(int i : s.chosenWords) chosenWords.push_back(s.words[i]);
+    for(int i = 0; i < s.words.size(); i++) {
+        bool isChosen = false;
+        for(word w : chosenWords) {
+            if (s.words[i] == w) isChosen = true;
+        }
+        if (isChosen) filteredWords.push_back(s.words[i]);
+    }
+}
+
+void benchSelect() {
+    construct_trie();
+    bench.trie = &trie;
+    vector<vector<word>> found;
+    long long totalWords = 0;
+    for(const string &b : denseBoards(12)) {
+        setBoard(bench, b);
+        searchWords(bench);
+        if (bench.words.size() <= 1000) continue;
+        totalWords += bench.words.size();
+        found.push_back(bench.words);
+    }
+
+    auto run = [&](const char *name, const function<void(Solver&)> &choose, vector<vector<int>> &chosen) {
+        long long solved = 0, allocs = 0;
+        double seconds = 0;
+        chosen.assign(found.size(), vector<int>());
+        while(seconds < 1.0) {
+            for(int i = 0; i < found.size(); i++) {
+                clearWords(bench);
+                bench.words = found[i];
+                long long allocsBefore = allocCount;
+                auto start = chrono::steady_clock::now();
+                choose(bench);
+                seconds += secondsSince(start);
+                allocs += allocCount - allocsBefore;
+                chosen[i] = bench.chosenWords;
+                solved++;
+            }
+        }
+        cout << name << solved / seconds << " selections/s, " << (double) allocs / solved << " allocations/selection\n";
+        return solved / seconds;
+    };
+    cout << found.size() << " boards with over 1000 words, " << (double) totalWords / found.size() << " words/board\n";
+
+    vector<vector<int>> legacyChosen, newChosen;
+    vector<word> legacyFiltered;
+    double legacy = run("linear scans:             ", [&](Solver &s) {
+        legacyChooseWords(s);
+        legacyFiltered.clear();
+        legacyOrderOptimally(s, legacyFiltered);
+    }, legacyChosen);
+    double heap = run("ratio heap + prefix tree: ", [](Solver &s) {
+        chooseWords(s);
+        orderOptimally(s);
+    }, newChosen);
+
+    cout << "speedup: " << heap / legacy << "x\n";
+    cout << "same chosen words: " << (legacyChosen == newChosen ? "yes" : "NO") << '\n';
+}
+
+/*
+exact: reward gained by the exact selection over the greedy one on the
+recorded boards (and word-rich boards), and what it costs in latency
+*/
+void benchExact(const vector<string> &recorded) {
+    construct_trie();
+    bench.trie = &trie;
+
+    auto run = [&](const char *name, const vector<string> &boards) {
+        long long greedyReward = 0, exactReward = 0;
+        int improved = 0, timedOut = 0;
+        double greedySeconds = 0, exactSeconds = 0, slowest = 0;
+        for(const string &b : boards) {
+            setBoard(bench, b);
+            clearWords(bench);
+            searchWords(bench);
+
+            auto start = chrono::steady_clock::now();
+            chooseWords(bench);
+            greedySeconds += secondsSince(start);
+            start = chrono::steady_clock::now();
+            if (!chooseWordsExact(bench, 0.1)) timedOut++;
+            double seconds = secondsSince(start);
+            exactSeconds += seconds;
+            slowest = max(slowest, seconds);
+
+            int reward = 0;
+            for(int i : bench.chosenWords) reward += calculateReward(bench.words[i]);
+            greedyReward += bench.greedyReward;
+            exactReward += reward;
+            if (reward > bench.greedyReward) improved++;
+        }
+        cout << name << boards.size() << " boards: greedy reward " << (double) greedyReward / boards.size()
+             << ", exact reward " << (double) exactReward / boards.size() << " (+"
+             << 100.0 * (exactReward - greedyReward) / greedyReward << "%, better on " << improved << " boards)\n";
+        cout << "  greedy selection " << greedySeconds / boards.size() * 1000 << " ms/board, exact selection "
+             << exactSeconds / boards.size() * 1000 << " ms/board (slowest " << slowest * 1000 << " ms, "
+             << timedOut << " timed out at 100 ms)\n";
+    };
+    run("recorded:   ", recorded);
+    run("word-rich:  ", denseBoards(8));
+}
+
+/*
+live: time to the first word shown and to the final list in live mode,
+against the normal pipeline (which shows nothing until the list is final),
+with the greedy selection alone and with the exact selection
+*/
+void benchLive(const vector<string> &recorded) {
+    construct_trie();
+    bench.trie = &trie;
+
+    auto run = [&](const char *name, const vector<string> &boards) {
+        stringstream terminal;
+        LiveView view;
+        double first = 0, final = 0, normal = 0;
+        for(const string &b : boards) {
+            setBoard(bench, b);
+            clearWords(bench);
+            auto start = chrono::steady_clock::now();
+            searchWords(bench);
+            chooseWords(bench);
+            if (exactSeconds > 0) chooseWordsExact(bench, exactSeconds);
+            orderOptimally(bench);
+            normal += secondsSince(start);
+
+            clearWords(bench);
+            terminal.str("");
+            startLive(view, terminal);
+            solveLive(bench, view);
+            first += view.firstWordSeconds;
+            final += view.finalSeconds;
+        }
+        cout << name << "first word " << first / boards.size() * 1000 << " ms, final list "
+             << final / boards.size() * 1000 << " ms (normal pipeline: " << normal / boards.size() * 1000 << " ms)\n";
+    };
+    vector<string> dense = denseBoards(8);
+    for(double budget : {0.0, 0.1}) {
+        exactSeconds = budget;
+        cout << (budget > 0 ? "greedy + exact selection\n" : "greedy selection\n");
+        run("  recorded:  ", recorded);
+        run("  word-rich: ", dense);
+    }
+    exactSeconds = 0;
+}
+
+/*
+shapes: boards/sec of the forward search on 4x4, 5x5 and holed 5x5 boards,
+with the generic search (AnyShape) and with the search compiled for the
+board's shape; both must find the same words. Holed boards always use the
+generic search, so their two columns should match.
+*/
+// count seeded random rows x cols board strings (rows separated by '/'),
+// each cell a hole with probability holes
+vector<string> randomBoards(int rows, int cols, int count, double holes) {
+    mt19937 rng(rows * 100 + cols);
+    uniform_real_distribution<double> unit(0, 1);
+    vector<string> boards;
+    for(int i = 0; i < count; i++) {
+        string b;
+        for(int r = 0; r < rows; r++) {
+            if (r > 0) b += '/';
+            for(int c = 0; c < cols; c++) b += unit(rng) < holes ? '.' : englishLetters[rng() % englishLetters.size()];
+        }
+        boards.push_back(b);
+    }
+    return boards;
+}
+
+void benchShapes(const vector<string> &recorded) {
+    construct_trie();
+    bench.trie = &trie;
+    searchEngine = forwardEngine;
+
+    // Boards per second, and the words found on each board
+    auto time = [&](const vector<string> &boards, bool specialized, vector<size_t> &found) {
+        shapeSpecialization = specialized;
+        found.assign(boards.size(), 0);
+        long long solved = 0;
+        double seconds = 0;
+        while(seconds < 0.2) {
+            for(int i = 0; i < boards.size(); i++) {
+                setBoard(bench, boards[i]);
+                auto start = chrono::steady_clock::now();
+                searchWords(bench);
+                seconds += secondsSince(start);
+                found[i] = bench.words.size();
+                solved++;
+            }
+        }
+        return solved / seconds;
+    };
+    auto run = [&](const char *name, const vector<string> &boards) {
+        // Alternating rounds, best of each, so drift in machine speed hits both alike
+        vector<size_t> genericFound, fixedFound;
+        double generic = 0, fixed = 0;
+        for(int round = 0; round < 5; round++) {
+            generic = max(generic, time(boards, false, genericFound));
+            fixed = max(fixed, time(boards, true, fixedFound));
+        }
+        long long words = 0;
+        for(size_t n : fixedFound) words += n;
+        cout << name << (double) words / boards.size() << " words/board, generic " << generic
+             << " boards/s, specialized " << fixed << " boards/s (" << fixed / generic << "x)"
+             << (genericFound == fixedFound ? "" : " DIFFERENT WORDS") << "\n";
+    };
+    run("4x4 recorded:  ", recorded);
+    run("4x4 word-rich: ", denseBoards(8));
+    run("5x5:           ", randomBoards(5, 5, 50, 0));
+    run("5x5 holed:     ", randomBoards(5, 5, 50, 0.15));
+    shapeSpecialization = true;
+    searchEngine = autoEngine;
+}
+
+/*
+engines: per-board search time of the forward dfs and the reverse search,
+and of the auto selector (its choice plus the cost of choosing), on boards
+with the usual letter mix and on boards drawn from few letters; all three
+must find the same words
+*/
+// count seeded random rows x cols boards drawn from letters
+vector<string> boardsFrom(const string &letters, int rows, int cols, int count) {
+    mt19937 rng(letters.size() * 100 + rows * cols);
+    vector<string> boards;
+    for(int i = 0; i < count; i++) {
+        string b;
+        for(int r = 0; r < rows; r++) {
+            if (r > 0) b += '/';
+            for(int c = 0; c < cols; c++) b += letters[rng() % letters.size()];
+        }
+        boards.push_back(b);
+    }
+    return boards;
+}
+
+void benchEngines(const vector<string> &recorded) {
+    construct_trie();
+    bench.trie = &trie;
+    reverseIndexOf(trie); // built once, not part of any board's time
+
+    // Average microseconds per board, and the words found on each board
+    auto run = [&](const vector<string> &boards, SearchEngine engine, vector<size_t> &found, int &reversed) {
+        searchEngine = engine;
+        found.assign(boards.size(), 0);
+        reversed = 0;
+        long long solved = 0;
+        double seconds = 0;
+        while(seconds < 0.5) {
+            for(int i = 0; i < boards.size(); i++) {
+                setBoard(bench, boards[i]);
+                auto start = chrono::steady_clock::now();
+                searchWords(bench);
+                seconds += secondsSince(start);
+                found[i] = bench.words.size();
+                reversed += solved < boards.size() && bench.engineUsed == reverseEngine;
+                solved++;
+            }
+        }
+        return seconds / solved * 1e6;
+    };
+    auto compare = [&](const char *name, const vector<string> &boards) {
+        vector<size_t> forwardFound, reverseFound, autoFound;
+        int reversed;
+        double forward = run(boards, forwardEngine, forwardFound, reversed);
+        double reverse = run(boards, reverseEngine, reverseFound, reversed);
+        double chosen = run(boards, autoEngine, autoFound, reversed);
+        cout << name << "forward " << forward << " us, reverse " << reverse << " us, auto " << chosen
+             << " us (reverse on " << reversed << "/" << boards.size() << " boards)"
+             << (forwardFound == reverseFound && forwardFound == autoFound ? "" : ", DIFFERENT WORDS") << '\n';
+    };
+    compare("4x4 recorded:      ", recorded);
+    compare("4x4 dense:         ", denseBoards(20));
+    compare("4x4 from 6 letters:", boardsFrom("AEINST", 4, 4, 50));
+    compare("5x5:               ", boardsFrom(englishLetters, 5, 5, 50));
+    compare("5x5 from 6 letters:", boardsFrom("AEINST", 5, 5, 50));
+    compare("5x5 from 4 letters:", boardsFrom("AEST", 5, 5, 50));
+    compare("8x8:               ", boardsFrom(englishLetters, 8, 8, 10));
+    compare("8x8 from 5 letters:", boardsFrom("AERST", 8, 8, 10));
+    searchEngine = autoEngine;
+}
+
+/*
+bigrams: trie nodes the dfs enters and search time per board (fastest pass)
+with and without bigram pruning (Trie::needed against the board's bigrams), on the
+recorded boards, word-rich boards and 5x5 boards; both must find the same words
+*/
+// Trie nodes the dfs enters from cell (at trie node curr), itself included
+long long countVisits(const Adjacency &adj, int cell, CellMask visited, int curr) {
+    long long count = 1;
+    for(int k = 0; k < adj.neighborCount[cell]; k++) {
+        int next = adj.neighbors[cell][k];
+        if (visited & cellBit(next)) continue;
+        int child = trieChild(trie, curr, adj.letters[next]);
+        if (child == -1 || (trie.needed[child] & adj.missingBigrams)) continue;
+        count += countVisits(adj, next, visited | cellBit(next), child);
+    }
+    return count;
+}
+
+void benchBigrams(const vector<string> &recorded) {
+    construct_trie();
+    bench.trie = &trie;
+    searchEngine = forwardEngine;
+
+    auto summarize = chrono::steady_clock::now();
+    summarizeBigrams(trie);
+    cout << "summarizing " << trie.nodeCount << " trie nodes: " << secondsSince(summarize) * 1000 << " ms\n";
+
+    // {nodes entered per board, microseconds per board}
+    auto run = [&](const vector<string> &boards, bool prune, long long &found) {
+        bigramPruning = prune;
+        long long nodes = 0;
+        for(const string &b : boards) {
+            setBoard(bench, b);
+            for(int cell = 0; cell < bench.adj.rows * bench.adj.cols; cell++) {
+                int start = trieChild(trie, 0, bench.adj.letters[cell]);
+                if (start == -1 || (trie.needed[start] & bench.adj.missingBigrams)) continue;
+                nodes += countVisits(bench.adj, cell, cellBit(cell), start);
+            }
+        }
+        // The fastest pass over the boards, as the machine may be busy
+        double seconds = 0, best = 1e9;
+        found = 0;
+        for(int pass = 0; seconds < 1.0; pass++) {
+            double passSeconds = 0;
+            for(const string &b : boards) {
+                setBoard(bench, b);
+                auto start = chrono::steady_clock::now();
+                searchWords(bench);
+                passSeconds += secondsSince(start);
+                if (pass == 0) found += bench.words.size();
+            }
+            seconds += passSeconds;
+            best = min(best, passSeconds);
+        }
+        return make_pair((double) nodes / boards.size(), best / boards.size() * 1e6);
+    };
+    auto compare = [&](const char *name, const vector<string> &boards) {
+        long long plainFound, prunedFound;
+        pair<double,double> plain = run(boards, false, plainFound);
+        pair<double,double> pruned = run(boards, true, prunedFound);
+        cout << name << "nodes/board " << plain.first << " -> " << pruned.first << " ("
+             << 100 * (1 - pruned.first / plain.first) << "% fewer), us/board " << plain.second << " -> "
+             << pruned.second << " (" << plain.second / pruned.second << "x)"
+             << (plainFound == prunedFound ? "" : ", DIFFERENT WORDS") << '\n';
+    };
+    compare("4x4 recorded: ", recorded);
+    compare("4x4 dense:    ", denseBoards(20));
+    compare("5x5:          ", randomBoards(5, 5, 50, 0));
+    bigramPruning = true;
+    searchEngine = autoEngine;
+}
+
+/*
+dawg: memory, build time and search time of the plain trie from buildTrie
+against the minimized DAWG the solver uses; both must find the same words
+*/
+void benchDawg(const vector<string> &recorded) {
+    ifstream in(dictionaryTextPath);
+    vector<string> ws = readWords(in);
+
+    auto start = chrono::steady_clock::now();
+    Trie plain = buildTrie(ws);
+    double plainBuild = secondsSince(start);
+    start = chrono::steady_clock::now();
+    Trie dawg = minimizeTrie(plain);
+    double minimize = secondsSince(start);
+    summarizeBigrams(plain);
+    summarizeBigrams(dawg);
+    singleWordList(plain);
+    singleWordList(dawg);
+
+    // Bytes of the node array and its bigram summaries
+    auto bytes = [](const Trie &t) {
+        return (double) t.nodeCount * (sizeof(TrieNode) + sizeof(uint64_t));
+    };
+    cout << "words: " << ws.size() << '\n';
+    cout << "trie: " << plain.nodeCount << " nodes, " << bytes(plain) / 1024 << " KiB, built in "
+         << plainBuild * 1000 << " ms\n";
+    cout << "dawg: " << dawg.nodeCount << " nodes, " << bytes(dawg) / 1024 << " KiB ("
+         << bytes(plain) / bytes(dawg) << "x smaller), minimized in a further " << minimize * 1000 << " ms\n";
+
+    searchEngine = forwardEngine;
+    // Microseconds per board (fastest pass) and the words found on each board
+    auto run = [&](const Trie &t, const vector<string> &boards, vector<size_t> &found) {
+        bench.trie = &t;
+        double seconds = 0, best = 1e9;
+        found.assign(boards.size(), 0);
+        while(seconds < 1.0) {
+            double passSeconds = 0;
+            for(int i = 0; i < boards.size(); i++) {
+                setBoard(bench, boards[i]);
+                auto start = chrono::steady_clock::now();
+                searchWords(bench);
+                passSeconds += secondsSince(start);
+                found[i] = bench.words.size();
+            }
+            seconds += passSeconds;
+            best = min(best, passSeconds);
+        }
+        return best / boards.size() * 1e6;
+    };
+    auto compare = [&](const char *name, const vector<string> &boards) {
+        vector<size_t> plainFound, dawgFound;
+        double plainTime = run(plain, boards, plainFound);
+        double dawgTime = run(dawg, boards, dawgFound);
+        cout << name << "trie " << plainTime << " us/board, dawg " << dawgTime << " us/board ("
+             << plainTime / dawgTime << "x)" << (plainFound == dawgFound ? "" : ", DIFFERENT WORDS") << '\n';
+    };
+    compare("4x4 recorded: ", recorded);
+    compare("5x5:          ", randomBoards(5, 5, 50, 0));
+    compare("8x8:          ", randomBoards(8, 8, 10, 0));
+    bench.trie = &trie;
+    searchEngine = autoEngine;
+}
+
+/*
+dictionaries: load time and memory held for 1 to 5 overlapping word lists,
+merged into one trie against one trie per list, and the search time of the
+merged trie against a trie of just the list searched. The lists are
+variants of dictionary.txt: two editions that each drop a different 3% of
+the words, a list of words up to 8 letters, and a filtered list.
+*/
+void benchDictionaries(const vector<string> &recorded) {
+    ifstream in(dictionaryTextPath);
+    vector<string> ws = readWords(in);
+    hash<string> h;
+    vector<vector<string>> variants(5);
+    for(const string &w : ws) {
+        size_t k = h(w);
+        variants[0].push_back(w);
+        if (k % 100 >= 3) variants[1].push_back(w);
+        if ((k / 100) % 100 >= 3) variants[2].push_back(w);
+        if (w.size() <= 8) variants[3].push_back(w);
+        if (k % 50 != 7) variants[4].push_back(w);
+    }
+
+    // Builds t, returns {milliseconds, KiB held afterwards}
+    auto measure = [](const function<void()> &build) {
+        long long before = liveBytes;
+        auto start = chrono::steady_clock::now();
+        build();
+        return make_pair(secondsSince(start) * 1000, (liveBytes - before) / 1024.0);
+    };
+    for(int n = 1; n <= 5; n++) {
+        vector<vector<string>> lists(variants.begin(), variants.begin() + n);
+        Trie merged;
+        vector<Trie> separate(n);
+        pair<double,double> m = measure([&]() {
+            merged = buildWordLists(lists);
+            summarizeBigrams(merged);
+        });
+        pair<double,double> p = measure([&]() {
+            for(int i = 0; i < n; i++) {
+                separate[i] = buildDictionary(lists[i]);
+            }
+        });
+        cout << n << " list(s): merged " << merged.nodeCount << " nodes, " << m.second << " KiB, "
+             << m.first << " ms; separate " << p.second << " KiB, " << p.first << " ms ("
+             << p.second / m.second << "x the memory)\n";
+
+        if (n < 5) continue;
+        // Search time with each list, merged trie vs. that list's own trie
+        searchEngine = forwardEngine;
+        for(int i = 0; i < n; i++) {
+            auto run = [&](const Trie &t, int list, long long &found) {
+                bench.trie = &t;
+                bench.list = list;
+                found = 0;
+                double seconds = 0, best = 1e9;
+                while(seconds < 0.5) {
+                    double passSeconds = 0;
+                    for(const string &b : recorded) {
+                        setBoard(bench, b);
+                        auto start = chrono::steady_clock::now();
+                        searchWords(bench);
+                        passSeconds += secondsSince(start);
+                        if (seconds == 0) found += bench.words.size();
+                    }
+                    seconds += passSeconds;
+                    best = min(best, passSeconds);
+                }
+                return best / recorded.size() * 1e6;
+            };
+            long long mergedFound, ownFound;
+            double mergedTime = run(merged, i, mergedFound);
+            double ownTime = run(separate[i], 0, ownFound);
+            cout << "  list " << i << ": merged " << mergedTime << " us/board, own trie " << ownTime << " us/board"
+                 << (mergedFound == ownFound ? "" : ", DIFFERENT WORDS") << '\n';
+        }
+        bench.trie = &trie;
+        bench.list = 0;
+        searchEngine = autoEngine;
+    }
+}
+
+/*
+cache: time per board (fastest pass) to solve a board (search, choose and
+order) without the result cache, on a cache hit in the same orientation,
+and on a hit in another one (the board turned a quarter); each must give
+the same records as solving without the cache. Also the heap an entry takes
+*/
+void benchCache(const vector<string> &recorded) {
+    construct_trie();
+    bench.trie = &trie;
+    auto clearCache = [&]() {
+        resultCache.recent.clear();
+        resultCache.entries.clear();
+        resultCache.hits = resultCache.misses = 0;
+    };
+
+    // Microseconds per board, and each board's record
+    auto run = [&](const vector<string> &boards, vector<string> &records) {
+        double seconds = 0, best = 1e9;
+        records.assign(boards.size(), "");
+        while(seconds < 0.5) {
+            double passSeconds = 0;
+            for(int i = 0; i < boards.size(); i++) {
+                auto start = chrono::steady_clock::now();
+                BoardResult r = solveBoard(bench, boards[i]);
+                passSeconds += secondsSince(start);
+                records[i].clear();
+                appendResult(records[i], r);
+            }
+            seconds += passSeconds;
+            best = min(best, passSeconds);
+        }
+        return best / boards.size() * 1e6;
+    };
+    auto compare = [&](const char *name, const vector<string> &boards) {
+        vector<string> turned;
+        for(const string &b : boards) {
+            setBoard(bench, b);
+            turned.push_back(orientBoard(bench.board, 5));
+        }
+        vector<string> cold, coldTurned, same, other;
+        resultCache.capacity = 0;
+        double coldTime = run(boards, cold);
+        run(turned, coldTurned);
+
+        resultCache.capacity = defaultCacheEntries;
+        clearCache();
+        long long before = liveBytes;
+        for(const string &b : boards) solveBoard(bench, b);
+        long long entryBytes = (liveBytes - before) / resultCache.recent.size();
+        double sameTime = run(boards, same);
+        double otherTime = run(turned, other);
+        cout << name << "no cache " << coldTime << " us, same orientation " << sameTime << " us ("
+             << coldTime / sameTime << "x), turned " << otherTime << " us (" << coldTime / otherTime << "x), "
+             << entryBytes << " bytes/entry" << (cold == same && coldTurned == other ? "" : ", DIFFERENT RESULTS") << '\n';
+        clearCache();
+        resultCache.capacity = 0;
+    };
+    compare("4x4 recorded: ", recorded);
+    compare("4x4 dense:    ", denseBoards(20));
+    compare("5x5:          ", randomBoards(5, 5, 50, 0));
+    compare("5x5 holed:    ", randomBoards(5, 5, 50, 0.15));
+}
+
+/*
+print: time per board (fastest pass) to print a solved board's results the
+way the printers used to (a color looked up by name for every letter, and
+each piece streamed into cout) against rendering them into the reused buffer
+for one write, with and without colors. Both go to an in-memory stream, so
+only the formatting is timed, and the colored outputs must match.
+*/
+map<string,string> legacyColors = {
+    {"default", "\033[37m"},
+    {"white", "\033[1m\033[37m"},
+    {"blue","\033[1;34m" },
+    {"red","\033[1;31m"}
+};
+void legacyPrintWord(ostream &out, const word &w) {
+    for(letter l : w.path) {
+        string color = "white";
+        if (l.repeat) color = (l.repeatNum == 0) ? "blue" : "red";
+        out << legacyColors[color] << l.l << legacyColors["default"];
+    }
+}
+void legacyPrintResults(Solver &s, ostream &out) {
+    for(int i = 0; i < s.filteredWords.size(); i++) {
+        const word &w = s.words[s.filteredWords[i]];
+        if (i > 0 && !(w.path[0] == s.words[s.filteredWords[i-1]].path[0])) out << '\n';
+        legacyPrintWord(out, w);
+        out << '\n';
+    }
+    out << endl;
+    s.sortedWords.resize(s.words.size());
+    for(int i = 0; i < s.words.size(); i++) s.sortedWords[i] = i;
+    sort(s.sortedWords.begin(), s.sortedWords.end(), [&](int a, int b) {
+        return compareByLength(s.words[a], s.words[b]);
+    });
+    for(int i : s.sortedWords) {
+        if (!s.words[i].chosen) {
+            legacyPrintWord(out, s.words[i]);
+            out << '\n';
+        }
+    }
+    WordListStats all = {0,0,0}, chosen = {0,0,0};
+    for(const word &w : s.words) addWordStats(all, w);
+    for(int i : s.filteredWords) addWordStats(chosen, s.words[i]);
+    out << "total reward: " << all.totalReward << '\n';
+    out << "total words: " << all.numWords << '\n';
+    out << "chosen reward: " << chosen.totalReward << '\n';
+    out << "chosen words: " << chosen.numWords << '\n';
+}
+
+void benchPrint(const vector<string> &recorded) {
+    construct_trie();
+    auto compare = [&](const char *name, const vector<string> &boards) {
+        // Solve each board once and keep its solver, so only printing is timed
+        vector<Solver> solved(boards.size());
+        for(int i = 0; i < boards.size(); i++) {
+            solved[i].trie = &trie;
+            setBoard(solved[i], boards[i]);
+            solveWords(solved[i]);
+        }
+        // Microseconds per board, and the last pass's output
+        auto run = [&](const function<void(Solver&, ostream&)> &print, string &text) {
+            double seconds = 0, best = 1e9;
+            while(seconds < 0.5) {
+                ostringstream out;
+                auto start = chrono::steady_clock::now();
+                for(Solver &s : solved) print(s, out);
+                double passSeconds = secondsSince(start);
+                seconds += passSeconds;
+                best = min(best, passSeconds);
+                text = out.str();
+            }
+            return best / boards.size() * 1e6;
+        };
+        string legacyText, bufferedText, plainText;
+        double legacyTime = run(legacyPrintResults, legacyText);
+        double bufferedTime = run(printResults, bufferedText);
+        plainOutput = true;
+        double plainTime = run(printResults, plainText);
+        plainOutput = false;
+        cout << name << "streamed " << legacyTime << " us, buffered " << bufferedTime << " us ("
+             << legacyTime / bufferedTime << "x), plain " << plainTime << " us (" << legacyTime / plainTime << "x)"
+             << (legacyText == bufferedText ? "" : ", DIFFERENT OUTPUT") << '\n';
+    };
+    compare("4x4 recorded: ", recorded);
+    compare("4x4 dense:    ", denseBoards(20));
+    compare("5x5:          ", randomBoards(5, 5, 50, 0));
+}
+
+int main(int argc, char **argv) {
+    string mode = argc > 1 ? argv[1] : "";
+    vector<string> boards = recordedBoards();
+
+    if (mode == "trie") benchTrie(boards);
+    else if (mode == "dictionary") benchDictionary();
+    else if (mode == "search") benchSearch(boards);
+    else if (mode == "threads") benchThreads(boards);
+    else if (mode == "batch") benchBatch(boards);
+    else if (mode == "select") benchSelect();
+    else if (mode == "exact") benchExact(boards);
+    else if (mode == "live") benchLive(boards);
+    else if (mode == "shapes") benchShapes(boards);
+    else if (mode == "engines") benchEngines(boards);
+    else if (mode == "bigrams") benchBigrams(boards);
+    else if (mode == "dawg") benchDawg(boards);
+    else if (mode == "dictionaries") benchDictionaries(boards);
+    else if (mode == "cache") benchCache(boards);
+    else if (mode == "print") benchPrint(boards);
+    else {
+        cout << "usage: SolverBenchmark trie|dictionary|search|threads|batch|select|exact|live|shapes|engines|bigrams|dawg|dictionaries|cache|print" << endl;
+        return 1;
+    }
+}
@@ -14,7 +14,11 @@
  * 
  * Usage:
  * Hit run, and input the board in the form of a lowercase string, with no spaces.
- * The solved board will be printed to "solved.txt" (takes less than a second).
+ * The solved board will be printed to the terminal (takes less than a second).
+ * The solver then asks for the next board, until the input ends (Ctrl-D).
+ *
+ * Build with -DEMBEDDED_DICTIONARY to link the dictionary into the executable
+ * (see --embed-dictionary below); the binary then needs no files at runtime.
  */
 
 #include <fstream>
@@ -23,9 +27,35 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <atomic>
 #include <limits>
+#include <list>
 #include <set>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 #include "FinalWordHuntSolver.h"
+#include "ThreadPool.h"
+#ifdef EMBEDDED_DICTIONARY
+#include "EmbeddedDictionary.h"
+#endif
+#ifdef WORDHUNT_PROFILE
+#include <sys/resource.h>
+#endif
 using namespace std;
 
 // Debug template (ignore)
@@ -36,191 +66,1316 @@ using namespace std;
 #define DEBUG(...) 47;
 #endif
 
+/*
+Profiling
+Built with -DWORDHUNT_PROFILE, the solver times its phases and counts what
+the search does, and --profile writes it all out as JSON with the allocation
+count and peak memory. Otherwise the PROFILE_ macros expand to nothing.
+Each thread counts into its own ProfileCounts, so the dfs never shares a
+cache line with another thread; a thread's counts are added to the
+retired ones when it exits.
+*/
+#ifdef WORDHUNT_PROFILE
+const char *phaseNames[phaseCount] = {
+    "loadDictionary", "inputBoard", "setBoard", "searchWords", "chooseWords", "chooseWordsExact",
+    "orderOptimally", "printFilteredWords", "printAdditionalWords", "trackStats", "appendResult"
+};
+const char *counterNames[counterCount] = {
+    "dfsNodes", "trieLookups", "noChild", "bigramPruned", "listPruned", "wordsFound", "reverseCandidates"
+};
+
+mutex profileMutex;
+ProfileCounts retiredProfile = {};
+set<ProfileCounts*> threadProfiles; // of the running threads
+
+void addProfile(ProfileCounts &into, const ProfileCounts &from) {
+    for(int i = 0; i < phaseCount; i++) {
+        into.phases[i].calls += from.phases[i].calls;
+        into.phases[i].nanoseconds += from.phases[i].nanoseconds;
+        into.phases[i].maxNanoseconds = max(into.phases[i].maxNanoseconds, from.phases[i].maxNanoseconds);
+    }
+    for(int i = 0; i < counterCount; i++) into.counters[i] += from.counters[i];
+}
+
+struct ThreadProfile {
+    ProfileCounts counts = {};
+    ThreadProfile() {
+        lock_guard<mutex> lock(profileMutex);
+        threadProfiles.insert(&counts);
+    }
+    ~ThreadProfile() {
+        lock_guard<mutex> lock(profileMutex);
+        addProfile(retiredProfile, counts);
+        threadProfiles.erase(&counts);
+    }
+};
+thread_local ThreadProfile threadProfile;
+
+// Times one call of a phase, from construction to destruction
+class PhaseTimer {
+public:
+    explicit PhaseTimer(ProfilePhase phase) : phase(phase), start(chrono::steady_clock::now()) {}
+    ~PhaseTimer() {
+        long long ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        PhaseStats &p = threadProfile.counts.phases[phase];
+        p.calls++;
+        p.nanoseconds += ns;
+        p.maxNanoseconds = max(p.maxNanoseconds, ns);
+    }
+private:
+    ProfilePhase phase;
+    chrono::steady_clock::time_point start;
+};
+
+// Counts a trie lookup of the dfs, and why it skips the child (-1: none), if it does
+void profileStep(const SearchContext &ctx, int child) {
+    long long *counters = threadProfile.counts.counters;
+    counters[trieLookupsCounter]++;
+    if (child == -1) counters[noChildCounter]++;
+    else if (ctx.trie->needed[child] & ctx.adj->missingBigrams) counters[bigramPrunedCounter]++;
+    else if (!(ctx.trie->lists[child] & listReachBit(ctx.list))) counters[listPrunedCounter]++;
+}
+
+#define PROFILE_PHASE(phase) PhaseTimer profileTimer(phase)
+#define PROFILE_COUNT(counter) (threadProfile.counts.counters[counter]++)
+#define PROFILE_STEP(ctx, child) profileStep(ctx, child)
+
+// Every allocation of the program; the benchmarks, which include this file,
+// count allocations themselves
+#ifndef WORDHUNT_NO_MAIN
+atomic<long long> allocations(0), allocatedBytes(0);
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    allocatedBytes.fetch_add(size, memory_order_relaxed);
+    void *p = malloc(size);
+    if (!p) throw bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+// Kept out of line: inlined, the free looks to GCC like it releases memory
+// from operator new (-Wmismatched-new-delete)
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    free(p);
+}
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+__attribute__((noinline)) void operator delete[](void *p) noexcept {
+    free(p);
+}
+__attribute__((noinline)) void operator delete[](void *p, size_t) noexcept {
+    free(p);
+}
+#endif
+#else
+#define PROFILE_PHASE(phase)
+#define PROFILE_COUNT(counter)
+#define PROFILE_STEP(ctx, child)
+#endif
+
 /*
 Global variables
 */
-const int N = 4;
 const int complexityBound = 1000;
 const int baseComplexity = 50;
 const int diagComplexity = 10;
 const int repeatComplexity = 10;
 
-map<int,int> points = {{3,100}, {4,400}, {5, 800}, {6, 1400},
-    {7, 1800}, {8, 2200}, {9, 2600}, {10, 3000}, {11, 3400}, {12, 3800}};
-map<int,int> similarityWorth = {{0,0},{1,0},{2,0},{3,5},{4,10},{5,50},
-    {6,1000},{7,1000},{8,1000},{9,1000},{10,1000}};
+map<int,int> points = []() {
+    map<int,int> p = {{3,100}, {4,400}, {5, 800}, {6, 1400},
+        {7, 1800}, {8, 2200}, {9, 2600}, {10, 3000}, {11, 3400}, {12, 3800}};
+    // Longer words (mostly on 5x5 boards) keep gaining 400 a letter
+    for(int length = 13; length <= maxBoardCells; length++) p[length] = p[length - 1] + 400;
+    return p;
+}();
+map<int,int> similarityWorth = []() {
+    map<int,int> w = {{0,0},{1,0},{2,0},{3,5},{4,10},{5,50},
+        {6,1000},{7,1000},{8,1000},{9,1000},{10,1000}};
+    // Words can share up to a whole board's path; sharing more is never worth less
+    for(int shared = 11; shared <= maxBoardCells; shared++) w[shared] = w[shared - 1];
+    return w;
+}();
+
+constexpr pair<int,int> directions[8] = {{-1,1},{0,1},{1,1},{1,0},{1,-1},{0,-1},{-1,-1},{-1,0}};
+
+// The dictionary, loaded once and shared (read-only) by every Solver
+Trie trie;
+
+// --exact: time budget of the exact selection per board (0 = greedy only)
+double exactSeconds = 0;
 
-vector<vector<char>> board;
-vector<word> words; // all possible words
-vector<word> chosenWords; // the subset of words we choose
-vector<word> filteredWords; //chosenWords but in optimal order
-TrieNode root;
+// Skip trie nodes whose words need bigrams the board lacks (see Step 3)
+bool bigramPruning = true;
 
-ifstream fin("InputOutput/dictionary.txt");
-ofstream fout("InputOutput/solved.txt");
+// Search full 4x4 and 5x5 boards with their compiled shapes (see Board shapes)
+bool shapeSpecialization = true;
+
+// --engine: how searchWords finds the words (see Reverse search)
+SearchEngine searchEngine = autoEngine;
+
+// --dictionary: the word lists in the shared trie, if not the default one
+vector<Dictionary> dictionaries;
+
+const string dictionaryTextPath = "InputOutput/dictionary.txt";
+const string dictionaryImagePath = "InputOutput/dictionary.bin";
+const string embeddedDictionaryPath = "EmbeddedDictionary.h";
 
 /*
 Step 1:
-Parses words from dictionary.txt and
-creates a trie to store all the words
+Uses the dictionary embedded at build time if there is one. Otherwise loads
+the compiled dictionary image if there is a valid one, otherwise parses
+words from dictionary.txt and creates a trie to store all the words,
+minimized into a DAWG so shared endings are stored once
 */
-void construct_trie() {
+
+// Reads every word (uppercased, letters only) from a stream, sorted and deduplicated
+vector<string> readWords(istream &in) {
+    vector<string> ws;
     string w;
-    while(fin >> w) {
-        TrieNode *curr = &root;
-        for(int i = 0; i < w.size(); i++) {
-            char l = w[i];
-            if(curr->children.find(l) == curr->children.end()) {
-                curr->children[l] = new TrieNode;
+    while(in >> w) {
+        bool valid = true;
+        for(char &c : w) {
+            c = toupper(c);
+            if (c < 'A' || c > 'Z') valid = false;
+        }
+        if (valid) ws.push_back(w);
+    }
+    sort(ws.begin(), ws.end());
+    ws.erase(unique(ws.begin(), ws.end()), ws.end());
+    return ws;
+}
+
+// Fills t.needed. One pass finds each node's letter (a shared block of
+// children always has the same letters), then each node folds in its
+// children: the bigrams every child's words need, plus the step from the
+// node's letter to the child's. Every node is summarized once, children first.
+void summarizeBigrams(Trie &t) {
+    vector<uint8_t> letter(t.nodeCount, 26);
+    for(uint32_t i = 0; i < t.nodeCount; i++) {
+        uint32_t children = t.nodes[i].mask & letterBits;
+        for(int child = t.nodes[i].firstChild; children; children &= children - 1, child++) {
+            letter[child] = __builtin_ctz(children);
+        }
+    }
+
+    vector<uint64_t> &summary = t.neededStorage;
+    summary.assign(t.nodeCount, 0);
+    vector<bool> done(t.nodeCount, false);
+    function<uint64_t(uint32_t)> summarize = [&](uint32_t i) {
+        if (done[i]) return summary[i];
+        done[i] = true;
+        uint32_t children = t.nodes[i].mask & letterBits;
+        if ((t.nodes[i].mask & isWordBit) || !children) return summary[i] = 0;
+        uint64_t needed = ~(uint64_t) 0;
+        for(int child = t.nodes[i].firstChild; children; children &= children - 1, child++) {
+            uint64_t step = letter[i] < 26 ? bigramBit(letter[i], letter[child]) : 0;
+            needed &= step | summarize(child);
+        }
+        return summary[i] = needed;
+    };
+    for(uint32_t i = 0; i < t.nodeCount; i++) summarize(i);
+    t.needed = summary.data();
+}
+
+// Builds the trie breadth-first from a sorted word list, so that the children
+// of every node are allocated next to each other (and after the node). Each
+// node covers the range of words that share its prefix.
+Trie buildTrie(const vector<string> &ws) {
+    Trie t;
+    vector<TrieNode> &nodes = t.storage;
+    vector<pair<int,int>> range = {{0, (int)ws.size()}};
+    nodes.push_back({0, 0, 0});
+
+    for(int i = 0, depth = 0, levelEnd = 1; i < nodes.size(); i++) {
+        if (i == levelEnd) { depth++; levelEnd = nodes.size(); }
+        int lo = range[i].first, hi = range[i].second;
+
+        if (lo < hi && ws[lo].size() == depth) {
+            nodes[i].mask |= isWordBit;
+            lo++;
+        }
+        nodes[i].firstChild = nodes.size();
+        while(lo < hi) {
+            char l = ws[lo][depth];
+            int end = lo;
+            while(end < hi && ws[end][depth] == l) end++;
+
+            nodes[i].mask |= 1u << (l - 'A');
+            nodes.push_back({0, 0, (uint32_t) (lo - range[i].first)});
+            range.push_back({lo, end});
+            lo = end;
+        }
+    }
+    nodes.shrink_to_fit();
+    t.nodes = nodes.data();
+    t.nodeCount = nodes.size();
+    t.wordCount = ws.size();
+    return t;
+}
+
+// Merges the nodes of a trie from buildTrie that have the same words below
+// them (the same mask and, once merged, the same children) into a DAWG. The
+// classes are found bottom up, then laid out breadth-first from the root,
+// each class's block of children at the first node that reaches it.
+Trie minimizeTrie(const Trie &t) {
+    vector<uint32_t> state(t.nodeCount); // each trie node's class
+    vector<uint32_t> rep; // a trie node of each class
+    unordered_map<string, uint32_t> classes;
+    string key;
+    for(uint32_t i = t.nodeCount; i-- > 0;) {
+        const TrieNode &n = t.nodes[i];
+        key.assign((const char*) &n.mask, sizeof(n.mask));
+        if (t.lists) key.append((const char*) &t.lists[i], sizeof(t.lists[i]));
+        uint32_t children = n.mask & letterBits;
+        for(uint32_t child = n.firstChild; children; children &= children - 1, child++) {
+            key.append((const char*) &state[child], sizeof(state[child]));
+        }
+        auto found = classes.emplace(key, rep.size());
+        if (found.second) rep.push_back(i);
+        state[i] = found.first->second;
+    }
+
+    Trie d;
+    vector<TrieNode> &nodes = d.storage;
+    vector<uint32_t> classOf = {state[0]};
+    vector<uint32_t> block(rep.size(), UINT32_MAX);
+    nodes.push_back({t.nodes[0].mask, 0, 0});
+    if (t.lists) d.listStorage.push_back(t.lists[0]);
+    for(size_t i = 0; i < nodes.size(); i++) {
+        uint32_t c = classOf[i];
+        if (block[c] == UINT32_MAX) {
+            block[c] = nodes.size();
+            const TrieNode &n = t.nodes[rep[c]];
+            uint32_t children = n.mask & letterBits;
+            for(uint32_t child = n.firstChild; children; children &= children - 1, child++) {
+                nodes.push_back(t.nodes[child]);
+                if (t.lists) d.listStorage.push_back(t.lists[child]);
+                classOf.push_back(state[child]);
+            }
+        }
+        nodes[i].firstChild = block[c];
+    }
+    nodes.shrink_to_fit();
+    d.nodes = nodes.data();
+    d.nodeCount = nodes.size();
+    d.wordCount = t.wordCount;
+    if (t.lists) d.lists = d.listStorage.data();
+    return d;
+}
+
+// Fills t.lists for a trie from buildTrie whose word with id i is in the
+// lists set in wordLists[i]. Children come after their parent, so one pass
+// down finds each node's id and one pass back up gathers the lists below.
+void summarizeLists(Trie &t, const vector<uint32_t> &wordLists) {
+    vector<uint32_t> id(t.nodeCount, 0);
+    vector<uint32_t> &lists = t.listStorage;
+    lists.assign(t.nodeCount, 0);
+    for(uint32_t i = 0; i < t.nodeCount; i++) {
+        if (t.nodes[i].mask & isWordBit) lists[i] = wordLists[id[i]];
+        uint32_t children = t.nodes[i].mask & letterBits;
+        for(uint32_t child = t.nodes[i].firstChild; children; children &= children - 1, child++) {
+            id[child] = id[i] + t.nodes[child].wordsBefore;
+        }
+    }
+    for(uint32_t i = t.nodeCount; i-- > 0;) {
+        lists[i] |= lists[i] << 16;
+        uint32_t children = t.nodes[i].mask & letterBits;
+        for(uint32_t child = t.nodes[i].firstChild; children; children &= children - 1, child++) {
+            lists[i] |= lists[child] & 0xffff0000u;
+        }
+    }
+    t.lists = lists.data();
+}
+
+// Fills t.lists for a trie holding a single list, where every node leads to a word
+void singleWordList(Trie &t) {
+    t.listStorage.resize(t.nodeCount);
+    for(uint32_t i = 0; i < t.nodeCount; i++) {
+        t.listStorage[i] = listReachBit(0) | ((t.nodes[i].mask & isWordBit) ? listWordBit(0) : 0);
+    }
+    t.lists = t.listStorage.data();
+}
+
+// The dictionary as the solver uses it, from a sorted word list: minimized,
+// with its bigram summaries and a single word list
+Trie buildDictionary(const vector<string> &ws) {
+    Trie t = minimizeTrie(buildTrie(ws));
+    summarizeBigrams(t);
+    singleWordList(t);
+    return t;
+}
+
+// FNV-1a over the arrays of a dictionary image, one 32-bit word at a time,
+// continuing from h (2166136261 to start)
+uint32_t imageChecksum(uint32_t h, const void *data, size_t bytes) {
+    const uint32_t *p = (const uint32_t*) data;
+    for(size_t i = 0; i < bytes / sizeof(uint32_t); i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+// The checksum of a dictionary image: its header (checksum field zeroed),
+// then needed, nodes and lists
+uint32_t dictionaryChecksum(DictionaryHeader h, const uint64_t *needed, const TrieNode *nodes, const uint32_t *lists) {
+    h.checksum = 0;
+    uint32_t c = imageChecksum(2166136261u, &h, sizeof(h));
+    c = imageChecksum(c, needed, (size_t) h.nodeCount * sizeof(uint64_t));
+    c = imageChecksum(c, nodes, (size_t) h.nodeCount * sizeof(TrieNode));
+    return imageChecksum(c, lists, (size_t) h.nodeCount * sizeof(uint32_t));
+}
+
+// Counts the words of a trie from its nodes alone. A child's wordsBefore
+// counts its parent's word and its earlier siblings' words, so a node has
+// its last child's wordsBefore plus the last child's words. Returns -1 if
+// some block of children runs past the end of nodes.
+long long countWords(const TrieNode *nodes, uint32_t nodeCount) {
+    for(uint32_t i = 0; i < nodeCount; i++) {
+        if ((uint64_t) nodes[i].firstChild + __builtin_popcount(nodes[i].mask & letterBits) > nodeCount) return -1;
+    }
+    long long words = 0;
+    uint32_t node = 0;
+    for(uint32_t depth = 0; depth < nodeCount; depth++) {
+        int children = __builtin_popcount(nodes[node].mask & letterBits);
+        if (!children) return words + ((nodes[node].mask & isWordBit) ? 1 : 0);
+        node = nodes[node].firstChild + children - 1;
+        words += nodes[node].wordsBefore;
+    }
+    return -1; // a cycle
+}
+
+// Size and modification time of the text dictionary at path; false if it is missing
+bool sourceStamp(const string &path, uint64_t &size, int64_t &modified) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    size = st.st_size;
+    modified = st.st_mtime;
+    return true;
+}
+
+// Writes the trie, compiled from the text dictionary at source, as a
+// dictionary image; returns whether it succeeded
+bool writeDictionaryImage(const Trie &t, const string &path, const string &source) {
+    DictionaryHeader h = {};
+    memcpy(h.magic, dictionaryMagic, sizeof(h.magic));
+    h.version = dictionaryVersion;
+    h.nodeCount = t.nodeCount;
+    h.wordCount = t.wordCount;
+    sourceStamp(source, h.sourceSize, h.sourceModified);
+    h.checksum = dictionaryChecksum(h, t.needed, t.nodes, t.lists);
+
+    ofstream out(path, ios::binary);
+    out.write((const char*) &h, sizeof(h));
+    out.write((const char*) t.needed, (size_t) t.nodeCount * sizeof(uint64_t));
+    out.write((const char*) t.nodes, (size_t) t.nodeCount * sizeof(TrieNode));
+    out.write((const char*) t.lists, (size_t) t.nodeCount * sizeof(uint32_t));
+    return (bool) out;
+}
+
+// Maps a dictionary image read-only and points t at it without copying.
+// Returns false (leaving t untouched) if the file is missing, not a valid
+// image, or older than the text dictionary at source (if that is there).
+bool loadDictionaryImage(Trie &t, const string &path, const string &source) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= sizeof(DictionaryHeader)) {
+        data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        cerr << path << ": could not map dictionary image" << endl;
+        return false;
+    }
+
+    const DictionaryHeader *h = (const DictionaryHeader*) data;
+    const uint64_t *needed = (const uint64_t*) ((char*) data + sizeof(DictionaryHeader));
+    const TrieNode *nodes = (const TrieNode*) (needed + h->nodeCount);
+    const uint32_t *lists = (const uint32_t*) (nodes + h->nodeCount);
+    const size_t nodeBytes = sizeof(uint64_t) + sizeof(TrieNode) + sizeof(uint32_t);
+    string error;
+    if (memcmp(h->magic, dictionaryMagic, sizeof(h->magic)) != 0) error = "not a dictionary image";
+    else if (h->version != dictionaryVersion) error = "unsupported version " + to_string(h->version);
+    else if (st.st_size != sizeof(DictionaryHeader) + (size_t) h->nodeCount * nodeBytes) error = "truncated";
+    else if (h->nodeCount == 0 || dictionaryChecksum(*h, needed, nodes, lists) != h->checksum) error = "checksum mismatch";
+    // wordCount sizes every search's foundEpoch, so it must match the nodes
+    else if (countWords(nodes, h->nodeCount) != h->wordCount) error = "word count does not match the nodes";
+    else {
+        uint64_t size;
+        int64_t modified;
+        if (sourceStamp(source, size, modified) && (size != h->sourceSize || modified != h->sourceModified)) {
+            error = "out of date with " + source;
+        }
+    }
+
+    if (!error.empty()) {
+        cerr << path << ": " << error << endl;
+        munmap(data, st.st_size);
+        return false;
+    }
+
+    t.storage.clear();
+    t.neededStorage.clear();
+    t.listStorage.clear();
+    t.nodes = nodes;
+    t.needed = needed;
+    t.lists = lists;
+    t.nodeCount = h->nodeCount;
+    t.wordCount = h->wordCount;
+    t.reverse.reset(new ReverseIndexSlot());
+    return true;
+}
+
+// Writes the trie as a C++ header holding a static node table, which a build
+// with -DEMBEDDED_DICTIONARY compiles straight into the executable
+bool writeEmbeddedDictionary(const Trie &t, const string &path, const string &source) {
+    ofstream out(path);
+    out << "// Generated from " << source << " by FinalWordHuntSolver --embed-dictionary. Do not edit.\n";
+    out << "const uint32_t embeddedDictionaryVersion = " << dictionaryVersion << ";\n";
+    out << "const uint32_t embeddedNodeCount = " << t.nodeCount << ";\n";
+    out << "const uint32_t embeddedWordCount = " << t.wordCount << ";\n";
+    out << "const TrieNode embeddedNodes[] = {\n";
+    for(uint32_t i = 0; i < t.nodeCount; i++) {
+        out << '{' << t.nodes[i].mask << ',' << t.nodes[i].firstChild << ',' << t.nodes[i].wordsBefore << "},";
+        if (i % 8 == 7) out << '\n';
+    }
+    out << "\n};\nconst uint64_t embeddedNeeded[] = {\n" << hex;
+    for(uint32_t i = 0; i < t.nodeCount; i++) {
+        out << "0x" << t.needed[i] << ',';
+        if (i % 8 == 7) out << '\n';
+    }
+    out << "\n};\nconst uint32_t embeddedLists[] = {\n";
+    for(uint32_t i = 0; i < t.nodeCount; i++) {
+        out << "0x" << t.lists[i] << ',';
+        if (i % 8 == 7) out << '\n';
+    }
+    out << dec << "\n};\n";
+    return (bool) out;
+}
+
+// Loads the default dictionary: embedded, from its image, or from
+// dictionary.txt. Returns false (after printing why) if there is none.
+bool construct_trie() {
+    PROFILE_PHASE(loadPhase);
+#ifdef EMBEDDED_DICTIONARY
+    static_assert(embeddedDictionaryVersion == dictionaryVersion, "regenerate EmbeddedDictionary.h with --embed-dictionary");
+    trie.nodes = embeddedNodes;
+    trie.needed = embeddedNeeded;
+    trie.lists = embeddedLists;
+    trie.nodeCount = embeddedNodeCount;
+    trie.wordCount = embeddedWordCount;
+    trie.reverse.reset(new ReverseIndexSlot());
+#else
+    if (!loadDictionaryImage(trie, dictionaryImagePath, dictionaryTextPath)) {
+        ifstream fin(dictionaryTextPath);
+        if (!fin) {
+            cerr << dictionaryTextPath << ": could not open dictionary" << endl;
+            return false;
+        }
+        trie = buildDictionary(readWords(fin));
+        // An image that is there but could not be used is rebuilt for next time
+        if (fin.eof() && access(dictionaryImagePath.c_str(), F_OK) == 0) {
+            if (writeDictionaryImage(trie, dictionaryImagePath, dictionaryTextPath)) cerr << "rebuilt " << dictionaryImagePath << endl;
+            else cerr << dictionaryImagePath << ": could not rebuild the dictionary image" << endl;
+        }
+    }
+#endif
+    return true;
+}
+
+// Offline step: compiles a text dictionary into a dictionary image
+// (or, with embed set, into EmbeddedDictionary.h)
+int compileDictionary(const string &textPath, const string &outPath, bool embed) {
+    ifstream in(textPath);
+    if (!in) {
+        cerr << textPath << ": could not open dictionary" << endl;
+        return 1;
+    }
+    Trie t = buildDictionary(readWords(in));
+    bool written = embed ? writeEmbeddedDictionary(t, outPath, textPath)
+                         : writeDictionaryImage(t, outPath, textPath);
+    if (!written) {
+        cerr << outPath << ": could not write dictionary" << endl;
+        return 1;
+    }
+    cout << "Compiled " << t.wordCount << " words (" << t.nodeCount << " nodes) into " << outPath << endl;
+    return 0;
+}
+
+/*
+Dictionary registry
+--dictionary name=path, once per word list, loads each list from a text
+file into the one shared trie in place of the default dictionary. Lists
+overlap heavily (editions of the same word list, a filtered copy), so they
+are merged and minimized together and each shared word is stored once.
+The first list is the default; a board string "name:board" picks another.
+*/
+
+// Builds one trie holding every list (each sorted, as from readWords); a
+// word is in the lists it appears in
+Trie buildWordLists(const vector<vector<string>> &lists) {
+    // Merge the lists, taking the smallest word left in any of them each time
+    vector<string> ws;
+    vector<uint32_t> wordLists;
+    vector<size_t> next(lists.size(), 0);
+    while(true) {
+        const string *smallest = nullptr;
+        for(int i = 0; i < lists.size(); i++) {
+            if (next[i] < lists[i].size() && (!smallest || lists[i][next[i]] < *smallest)) smallest = &lists[i][next[i]];
+        }
+        if (!smallest) break;
+        ws.push_back(*smallest);
+        wordLists.push_back(0);
+        for(int i = 0; i < lists.size(); i++) {
+            if (next[i] < lists[i].size() && lists[i][next[i]] == ws.back()) {
+                wordLists.back() |= listWordBit(i);
+                next[i]++;
             }
-            curr = curr->children[l];
         }
-        curr->isWord = true;
     }
+    Trie t = buildTrie(ws);
+    summarizeLists(t, wordLists);
+    return minimizeTrie(t);
+}
+
+// Loads the registered dictionaries into the shared trie. Returns false if
+// one of them could not be read
+bool loadDictionaries() {
+    PROFILE_PHASE(loadPhase);
+    vector<vector<string>> lists;
+    for(const Dictionary &d : dictionaries) {
+        ifstream in(d.path);
+        if (!in) {
+            cerr << d.path << ": could not open dictionary" << endl;
+            return false;
+        }
+        lists.push_back(readWords(in));
+    }
+    trie = buildWordLists(lists);
+    summarizeBigrams(trie);
+    return true;
+}
+
+// The list of the dictionary called name, or -1 if there is none
+int findDictionary(const string &name) {
+    for(int i = 0; i < dictionaries.size(); i++) {
+        if (dictionaries[i].name == name) return i;
+    }
+    return -1;
+}
+
+// Splits a request "name:board" into the dictionary name and the board,
+// and sets s to solve with that dictionary's list (the default one if no
+// name is given). Returns an error message if there is no such dictionary.
+string selectDictionary(Solver &s, string &b, string &name) {
+    size_t colon = b.find(':');
+    name = colon == string::npos ? "" : b.substr(0, colon);
+    if (colon != string::npos) b.erase(0, colon + 1);
+    s.list = name.empty() ? 0 : findDictionary(name);
+    if (s.list == -1) {
+        s.list = 0;
+        return "unknown dictionary " + name;
+    }
+    return "";
 }
 
 /*
 Step 2:
 Reads in the user's board in the form of a string
-Ensures the string is 16 letters long
+The string is the board's letters row by row: 16 letters for a 4x4 board,
+25 for a 5x5 one (any square works), or rows separated by '/' for other
+shapes. A '.' is a hole: a cell that is not part of the board.
+The solver keeps running, so the dictionary is loaded once for every board
 */
-void inputBoard() {
-    // Reads in 16 letter long string
-    board.resize(N, vector<char>());
-    string bString;
 
-    // while(bString.size() != N*N) {
-    cout << "Input Board:" << endl;
-    cin >> bString;
-    // }
+// Splits a board string into its rows. Returns an error message if it is
+// not a valid board.
+string parseBoard(const string &b, vector<string> &rows) {
+    rows.clear();
+    if (b.empty()) return "empty board"; // e.g. "name:" with nothing after it
+    if (b.find('/') != string::npos) {
+        size_t begin = 0;
+        while(true) {
+            size_t end = b.find('/', begin);
+            rows.push_back(b.substr(begin, end == string::npos ? string::npos : end - begin));
+            if (end == string::npos) break;
+            begin = end + 1;
+        }
+    }
+    else {
+        int side = 0;
+        while((side + 1) * (side + 1) <= b.size()) side++;
+        if (side * side != b.size()) return "expected a square number of letters, or rows separated by '/'";
+        for(int r = 0; r < side; r++) rows.push_back(b.substr(r * side, side));
+    }
 
-    for(int i = 0; i < bString.size(); i++) {
-        bString[i] = toupper(bString[i]);
+    for(const string &row : rows) {
+        if (row.empty() || row.size() != rows[0].size()) return "rows must all have the same length";
+        for(char c : row) {
+            if (!isalpha((unsigned char) c) && c != '.') return "board must only contain letters and '.' for holes";
+        }
     }
+    if (rows.size() * rows[0].size() > maxBoardCells) return "board has more than " + to_string(maxBoardCells) + " cells";
+    return "";
+}
 
-    // Creates a 4x4 board
-    for(int i = 0; i < N; i++) {
-        for(int j = 0; j < N; j++) {
-            board[i].push_back(bString[i*N + j]);
+// Fills adj for a rows x cols board of letters (row-major). Neighbors are
+// listed in directions order, which is the order the dfs tries them in.
+// Holes (anything but A-Z) are left out of valid and are nobody's neighbor.
+void buildAdjacency(Adjacency &a, const vector<vector<char>> &b, int rows, int cols) {
+    a.rows = rows;
+    a.cols = cols;
+    a.valid = 0;
+    memset(a.letterMask, 0, sizeof(a.letterMask));
+    a.bigrams = 0;
+    for(int cell = 0; cell < rows * cols; cell++) {
+        char l = b[cell / cols][cell % cols];
+        a.letters[cell] = l;
+        if ('A' <= l && l <= 'Z') {
+            a.valid |= cellBit(cell);
+            a.letterMask[l - 'A'] |= cellBit(cell);
         }
     }
+
+    for(int cell = 0; cell < rows * cols; cell++) {
+        int r = cell / cols, c = cell % cols;
+        CellMask seen = 0;
+        a.neighborCount[cell] = 0;
+        a.diagonalMask[cell] = 0;
+        a.neighborLetters[cell] = 0;
+        memset(a.letterDirs[cell], 0, sizeof(a.letterDirs[cell]));
+        for(pair<int,int> offset : directions) {
+            int nr = r + offset.first, nc = c + offset.second;
+            if (nr < 0 || nr >= rows || nc < 0 || nc >= cols) continue;
+            int next = nr * cols + nc;
+            if (!(a.valid & cellBit(next))) continue;
+
+            int k = a.neighborCount[cell]++;
+            a.neighbors[cell][k] = next;
+            if (offset.first != 0 && offset.second != 0) a.diagonalMask[cell] |= cellBit(next);
+            a.before[cell][k] = seen;
+            seen |= cellBit(next);
+            a.neighborLetters[cell] |= 1u << (a.letters[next] - 'A');
+            a.letterDirs[cell][a.letters[next] - 'A'] |= 1 << k;
+            if (a.valid & cellBit(cell)) a.bigrams |= bigramBit(a.letters[cell] - 'A', a.letters[next] - 'A');
+        }
+        for(int l = 0; l < 26; l++) {
+            a.letterNeighbors[cell][l] = seen & a.letterMask[l];
+        }
+    }
+    a.missingBigrams = bigramPruning ? ~a.bigrams : 0;
+    bool full = a.valid == (rows * cols == maxBoardCells ? ~(CellMask) 0 : cellBit(rows * cols) - 1);
+    a.shape = anyShape;
+    if (shapeSpecialization && full && rows == 4 && cols == 4) a.shape = shape4x4;
+    if (shapeSpecialization && full && rows == 5 && cols == 5) a.shape = shape5x5;
+}
+
+// Creates the board from a board string (see parseBoard, which must accept it)
+void setBoard(Solver &s, string bString) {
+    PROFILE_PHASE(boardPhase);
+    vector<string> rows;
+    parseBoard(bString, rows);
+    s.board.assign(rows.size(), vector<char>());
+
+    for(int i = 0; i < rows.size(); i++) {
+        for(int j = 0; j < rows[i].size(); j++) {
+            s.board[i].push_back(toupper(rows[i][j]));
+        }
+    }
+    buildAdjacency(s.adj, s.board, rows.size(), rows[0].size());
+}
+
+// returns false once there are no more boards
+bool inputBoard(Solver &s) {
+    PROFILE_PHASE(inputPhase);
+    // Reads in the board string
+    string bString;
+    vector<string> rows;
+
+    while(true) {
+        cout << "Input Board:" << endl;
+        if (!(cin >> bString)) return false;
+        string name, error = selectDictionary(s, bString, name);
+        if (error.empty()) error = parseBoard(bString, rows);
+        if (error.empty()) break;
+        cout << error << endl;
+    }
+
+    setBoard(s, bString);
+    return true;
+}
+
+// Clears the previous board's results
+void clearWords(Solver &s) {
+    s.words.clear();
+    s.chosenWords.clear();
+    s.filteredWords.clear();
 }
 
 /*
 Step 3:
 Search (dfs) through all possible words
+The current path is kept in place in a SearchContext (a fixed-size stack plus
+a bitmask of the cells on it), so the recursion never allocates. A word is
+only copied out once the trie confirms it. Moves and the ambiguity of each
+step come from the board's precomputed adjacency tables (Solver::adj).
+From each cell the dfs only tries the neighbors whose letter is a child of
+the current trie node: the node's child letters, masked with the letters
+around the cell, select the directions to try (still in directions order).
+It also skips a child when some bigram every word below it needs (its
+Trie::needed signature) borders nowhere on the board, so whole subtrees
+that cannot finish a word are never entered.
+
+With a thread pool (--threads), every (start cell, first step) pair is a
+separate task. Each task collects its words in its own buffer, and the
+buffers are merged in task order, which is the order the serial dfs visits
+them in, so words comes out exactly the same.
 */
 
 /*
 Helper functions to
-1) ensure that the cell we are attempting to visit is within the 4x4 grid
-2) ensure that the cell is not already on the current path
-3) ensure that if we visit the cell, there is a word that exists along that path
-4) adds the word if it is valid (if it is marked in the trie as a word)
-5) find the complexity that a new letter adds (based on diagonals, repeat letters, etc.)
+1) ensure that the cell is not already on the current path
+2) ensure that if we visit the cell, there is a word that exists along that path
+   (the trie node's child letters pick the directions, see dfs)
+3) adds the word if it is valid (if it is marked in the trie as a word)
+4) find the complexity that a new letter adds (based on diagonals, repeat letters, etc.)
 */
 
-// Check if a letter's position + an offset stays in bounds
-bool inBounds(const letter &l, const pair<int,int> &offset) {
-    int x = l.row + offset.first; int y = l.col + offset.second;
-    return 0 <= x && x < N && 0 <= y && y < N;
+// Checks if a cell can be added to the current path
+// without causing a repeat
+bool notRepeated(const SearchContext &ctx, int cell) {
+    return !(ctx.state.visited & cellBit(cell));
 }
 
-// Checks if a letter l can be added to word w
-// without causing a repeat
-bool notRepeated(const letter &l, const word &w) {
-    for(letter used : w.path) {
-        if (l == used) return false;
+// Starts a new epoch: every word counts as not found yet
+void newSearchEpoch(SearchContext &ctx) {
+    if (ctx.foundEpoch.size() != ctx.trie->wordCount) ctx.foundEpoch.assign(ctx.trie->wordCount, 0);
+    if (++ctx.epoch == 0) {
+        fill(ctx.foundEpoch.begin(), ctx.foundEpoch.end(), 0);
+        ctx.epoch = 1;
     }
-    return true;
 }
 
-// Checks if we should prune the branch or not if we are at a letter l
-// and a TrieNode curr
-bool existsWord(const letter &l, const TrieNode* curr) {
-    return curr->children.find(l.l) != curr->children.end();
+/*
+Board shapes
+The dfs reads a board's geometry through a shape: which cell is a cell's
+k-th neighbor, whether stepping there is diagonal, which neighbors come
+before it, and a cell's row and column. AnyShape reads all of it from the
+board's Adjacency, so it works on every board, holes included. FixedShape
+has it as tables worked out at compile time for a full Rows x Cols board,
+so the dfs compiled for it reads constant arrays and divides by a constant
+column count. The letters are only known at run time, so letterDirs,
+neighborLetters and letterNeighbors still come from the Adjacency.
+Full 4x4 and 5x5 boards get their own compiled search (see searchFrom);
+every other board, and every board with shapeSpecialization off, uses
+AnyShape. SolverBenchmark shapes compares the two.
+*/
+struct AnyShape {
+    static int neighbor(const Adjacency &adj, int cell, int k) {
+        return adj.neighbors[cell][k];
+    }
+    static bool diagonal(const Adjacency &adj, int cell, int next) {
+        return (adj.diagonalMask[cell] & cellBit(next)) != 0;
+    }
+    static CellMask before(const Adjacency &adj, int cell, int k) {
+        return adj.before[cell][k];
+    }
+    static int cols(const Adjacency &adj) {
+        return adj.cols;
+    }
+};
+
+template<int Rows, int Cols>
+struct FixedShape {
+    static constexpr int cells = Rows * Cols;
+    struct Tables {
+        uint8_t neighbors[cells][8] = {};
+        CellMask diagonal[cells] = {};
+        CellMask before[cells][8] = {};
+    };
+    // The same tables buildAdjacency makes for a board without holes
+    static constexpr Tables build() {
+        Tables t;
+        for(int cell = 0; cell < cells; cell++) {
+            int r = cell / Cols, c = cell % Cols, k = 0;
+            CellMask seen = 0;
+            for(const pair<int,int> &offset : directions) {
+                int nr = r + offset.first, nc = c + offset.second;
+                if (nr < 0 || nr >= Rows || nc < 0 || nc >= Cols) continue;
+                int next = nr * Cols + nc;
+                t.neighbors[cell][k] = next;
+                if (offset.first != 0 && offset.second != 0) t.diagonal[cell] |= cellBit(next);
+                t.before[cell][k++] = seen;
+                seen |= cellBit(next);
+            }
+        }
+        return t;
+    }
+    static constexpr Tables tables = build();
+
+    static int neighbor(const Adjacency &, int cell, int k) {
+        return tables.neighbors[cell][k];
+    }
+    static bool diagonal(const Adjacency &, int cell, int next) {
+        return (tables.diagonal[cell] & cellBit(next)) != 0;
+    }
+    static CellMask before(const Adjacency &, int cell, int k) {
+        return tables.before[cell][k];
+    }
+    static constexpr int cols(const Adjacency &) {
+        return Cols;
+    }
+};
+
+// Stepping from cell to its k-th neighbor: counts the other unvisited neighbors
+// of cell with the same letter, and how many of them come before the k-th one
+template<class Shape = AnyShape>
+pair<int,int> repeats(const SearchContext &ctx, int cell, int k) {
+    const Adjacency &adj = *ctx.adj;
+    int next = Shape::neighbor(adj, cell, k);
+    CellMask same = adj.letterNeighbors[cell][adj.letters[next] - 'A'] & ~ctx.state.visited & ~cellBit(next);
+    return make_pair(__builtin_popcountll(same), __builtin_popcountll(same & Shape::before(adj, cell, k)));
+}
+
+// Pushes a step onto the current path
+void pushStep(SearchContext &ctx, const PathStep &p, int cChange) {
+    ctx.state.path[ctx.state.depth++] = p;
+    ctx.state.visited |= cellBit(p.cell);
+    ctx.state.complexity += cChange;
 }
 
-// Given a word and a current node, adds the word to words if it is valid
+// Pops the last step off the current path
+void popStep(SearchContext &ctx, int cChange) {
+    ctx.state.visited &= ~cellBit(ctx.state.path[--ctx.state.depth].cell);
+    ctx.state.complexity -= cChange;
+}
+
+// The functions below take the board's geometry from Shape (see Board shapes).
+// Holes need no special case, since the adjacency tables never list them as neighbors.
+
+// Sets path to the letters of the n steps from steps on adj's board
+template<class Shape = AnyShape>
+void stepLetters(const Adjacency &adj, const PathStep *steps, int n, vector<letter> &path) {
+    int cols = Shape::cols(adj);
+    path.clear();
+    path.reserve(n);
+    for(int i = 0; i < n; i++) {
+        const PathStep &p = steps[i];
+        path.push_back({adj.letters[p.cell], p.cell / cols, p.cell % cols, p.isDiag, p.repeat, p.repeatNum});
+    }
+}
+
+// Given the current node and the id of the path's prefix, adds the current path
+// to the found words if it is a valid word that was not already found this epoch.
 // returns whether a word was added
-bool addWord(const word &word, const TrieNode* curr) {
-    int n = word.path.size();
-    char c = word.path[n-1].l;
+template<class Shape = AnyShape>
+bool addWord(SearchContext &ctx, int curr, uint32_t id) {
+    int n = ctx.state.depth;
 
-    if (n >= 3 && curr->isWord) {
-        words.push_back(word); // WORDS MODIFIED HERE
+    if (n >= 3 && (ctx.trie->lists[curr] & listWordBit(ctx.list)) && ctx.foundEpoch[id] != ctx.epoch) {
+        vector<letter> path;
+        stepLetters<Shape>(*ctx.adj, ctx.state.path, n, path);
+        ctx.found->words.push_back({move(path), ctx.state.complexity, 0, false}); // WORDS MODIFIED HERE
+        ctx.found->ids.push_back(id);
+        ctx.foundEpoch[id] = ctx.epoch; //prevents repeats
+        PROFILE_COUNT(wordsFoundCounter);
         return true;
     }
     return false;
 }
 
-vector<pair<int,int>> directions = {{-1,1},{0,1},{1,1},{1,0},{1,-1},{0,-1},{-1,-1},{-1,0}};
+template<class Shape>
+void dfs(SearchContext &ctx, int curr, uint32_t id, int cell);
+
+// Extends the current path (ending at cell, trie node curr, prefix id) to cell's
+// k-th neighbor and searches everything past it
+template<class Shape>
+void step(SearchContext &ctx, int curr, uint32_t id, int cell, int k) {
+    const Adjacency &adj = *ctx.adj;
+    int next = Shape::neighbor(adj, cell, k);
+    if (!notRepeated(ctx, next)) return;
+    int child = trieChild(*ctx.trie, curr, adj.letters[next]);
+    PROFILE_STEP(ctx, child);
+    if (child == -1 || (ctx.trie->needed[child] & adj.missingBigrams) || !(ctx.trie->lists[child] & listReachBit(ctx.list))) return;
+
+    PathStep p = {(uint8_t) next, Shape::diagonal(adj, cell, next), 0, 0};
+    pair<int,int> r = repeats<Shape>(ctx, cell, k);
+    p.repeat = r.first;
+    p.repeatNum = r.second;
+    int cChange = p.isDiag * diagComplexity + p.repeat * repeatComplexity;
+
+    pushStep(ctx, p, cChange);
+    dfs<Shape>(ctx, child, id + ctx.trie->nodes[child].wordsBefore, next);
+    popStep(ctx, cChange);
+}
+
+// Recurses through every possible word from the end of the current path
+// (at cell, trie node curr, prefix id)
+template<class Shape>
+void dfs(SearchContext &ctx, int curr, uint32_t id, int cell) {
+    PROFILE_COUNT(dfsNodesCounter);
+    addWord<Shape>(ctx, curr, id);
+
+    const Adjacency &adj = *ctx.adj;
+    uint32_t letters = ctx.trie->nodes[curr].mask & adj.neighborLetters[cell];
+    unsigned dirs = 0;
+    for(; letters; letters &= letters - 1) dirs |= adj.letterDirs[cell][__builtin_ctz(letters)];
+
+    for(; dirs; dirs &= dirs - 1) {
+        step<Shape>(ctx, curr, id, cell, __builtin_ctz(dirs));
+    }
+}
+
+template<class Shape>
+void searchFromIn(SearchContext &ctx, int cell, int k) {
+    int start = trieChild(*ctx.trie, 0, ctx.adj->letters[cell]);
+    PROFILE_STEP(ctx, start);
+    if (start == -1 || (ctx.trie->needed[start] & ctx.adj->missingBigrams) || !(ctx.trie->lists[start] & listReachBit(ctx.list))) return;
 
-bool diagonal(const letter &l, const word &w) {
-    letter prev = w.path[w.path.size() - 1];
-    return (l.row - prev.row) != 0 && (l.col - prev.col) != 0;
+    ctx.state.depth = 0;
+    ctx.state.visited = 0;
+    ctx.state.complexity = baseComplexity;
+    pushStep(ctx, {(uint8_t) cell, false, 0, 0}, 0);
+    uint32_t id = ctx.trie->nodes[start].wordsBefore;
+    if (k < 0) dfs<Shape>(ctx, start, id, cell);
+    else step<Shape>(ctx, start, id, cell, k);
+    popStep(ctx, 0);
 }
 
-pair<int,int> repeats(const letter &l, const word &w) {
-    letter lastLetter = w.path[w.path.size() - 1];
-    int repeats = 0;
-    int lRepeatNum = 0; //if there are repeats, check if l is 1st or 2nd
-    for(pair<int,int> change : directions) {
-        if (!inBounds(lastLetter, change)) continue;
+// Searches every word starting at cell (or, if k >= 0, only those whose
+// second letter is cell's k-th neighbor), with the search compiled for
+// the board's shape
+void searchFrom(SearchContext &ctx, int cell, int k) {
+    switch(ctx.adj->shape) {
+        case shape4x4: searchFromIn<FixedShape<4,4>>(ctx, cell, k); break;
+        case shape5x5: searchFromIn<FixedShape<5,5>>(ctx, cell, k); break;
+        default: searchFromIn<AnyShape>(ctx, cell, k);
+    }
+}
+
+// Points a search context at the solver's dictionary and board
+void attachSearch(Solver &s, SearchContext &ctx) {
+    ctx.trie = s.trie;
+    ctx.adj = &s.adj;
+    ctx.list = s.list;
+}
+
+// Starts a dfs with ctx at each cell of s's board, into s.words
+void searchEveryCell(Solver &s, SearchContext &ctx) {
+    newSearchEpoch(ctx);
+    ctx.found = &s.found;
+    s.found.words.clear();
+    s.found.ids.clear();
+
+    for(int cell = 0; cell < s.adj.rows * s.adj.cols; cell++) {
+        searchFrom(ctx, cell, -1);
+    }
+    s.words.swap(s.found.words);
+}
+
+void searchWordsSerial(Solver &s) {
+    attachSearch(s, s.search);
+    searchEveryCell(s, s.search);
+}
+
+// Spreads the (start cell, first step) pairs over the pool, then merges
+// the per-task buffers in task order, dropping words an earlier task found
+void searchWordsParallel(Solver &s, ThreadPool &pool) {
+    vector<pair<int,int>> &tasks = s.searchTasks;
+    tasks.clear();
+    for(int cell = 0; cell < s.adj.rows * s.adj.cols; cell++) {
+        if (trieChild(*s.trie, 0, s.adj.letters[cell]) == -1) continue;
+        for(int k = 0; k < s.adj.neighborCount[cell]; k++) tasks.push_back({cell, k});
+    }
+    if (s.taskFound.size() < tasks.size()) s.taskFound.resize(tasks.size());
+    s.workerSearch.resize(pool.size());
+    for(SearchContext &ctx : s.workerSearch) attachSearch(s, ctx);
+
+    pool.parallelFor(tasks.size(), [&](int t, int worker) {
+        SearchContext &ctx = s.workerSearch[worker];
+        newSearchEpoch(ctx);
+        ctx.found = &s.taskFound[t];
+        ctx.found->words.clear();
+        ctx.found->ids.clear();
+        searchFrom(ctx, tasks[t].first, tasks[t].second);
+    });
+
+    attachSearch(s, s.search);
+    newSearchEpoch(s.search);
+    s.words.clear();
+    for(int t = 0; t < tasks.size(); t++) {
+        FoundWords &f = s.taskFound[t];
+        for(int i = 0; i < f.words.size(); i++) {
+            if (s.search.foundEpoch[f.ids[i]] == s.search.epoch) continue;
+            s.search.foundEpoch[f.ids[i]] = s.search.epoch;
+            s.words.push_back(move(f.words[i]));
+        }
+    }
+}
+
+/*
+Reverse search
+The other way around: rather than walking the board, take the dictionary
+words whose letter set is a subset of the board's, drop those with a
+letter used twice that is on one cell of the board or a bigram no two adjacent
+cells spell, and look for a path for each survivor. The path search tries
+directions in dfs order, so it finds the path the dfs would find first, and
+sorting the words by their paths' directions puts them in dfs order: the
+result is the same as the forward search.
+
+It is cheap when the board has few distinct letters (few letter subsets to
+look up) and the forward dfs would wander through many paths.
+*/
+
+// Builds the reverse index of t's words by walking the trie
+void buildReverseIndex(ReverseIndex &index, const Trie &t) {
+    // The words in trie order, with their letter sets and signatures
+    char w[maxBoardCells];
+    int n = 0;
+    vector<char> letters;
+    vector<uint32_t> offset, node, ids, repeated;
+    vector<uint64_t> bigrams;
+    vector<pair<uint32_t,uint32_t>> byLetters; // (letter set, word)
+    byLetters.reserve(t.wordCount);
+    offset.reserve(t.wordCount + 1);
+    node.reserve(t.wordCount);
+    ids.reserve(t.wordCount);
+    repeated.reserve(t.wordCount);
+    bigrams.reserve(t.wordCount);
+    function<void(int,uint32_t)> walk = [&](int curr, uint32_t id) {
+        if (n >= 3 && (t.nodes[curr].mask & isWordBit)) {
+            uint32_t seen = 0, twice = 0;
+            uint64_t pairs = 0;
+            for(int j = 0; j < n; j++) {
+                int l = w[j] - 'A';
+                if (seen & (1u << l)) twice |= 1u << l;
+                seen |= 1u << l;
+                if (j > 0) pairs |= bigramBit(w[j-1] - 'A', l);
+            }
+            byLetters.push_back({seen, (uint32_t) node.size()});
+            offset.push_back(letters.size());
+            letters.insert(letters.end(), w, w + n);
+            node.push_back(curr);
+            ids.push_back(id);
+            repeated.push_back(twice);
+            bigrams.push_back(pairs);
+        }
+        if (n == maxBoardCells) return;
+        uint32_t children = t.nodes[curr].mask & ~isWordBit;
+        for(int child = t.nodes[curr].firstChild; children; children &= children - 1, child++) {
+            w[n++] = 'A' + __builtin_ctz(children);
+            walk(child, id + t.nodes[child].wordsBefore);
+            n--;
+        }
+    };
+    walk(0, 0);
+    offset.push_back(letters.size());
+    sort(byLetters.begin(), byLetters.end());
 
-        letter n;
-        n.row = lastLetter.row + change.first;
-        n.col = lastLetter.col + change.second;
+    // Laid out again grouped by letter set
+    index.letters.reserve(letters.size());
+    index.offset.reserve(node.size() + 1);
+    index.offset.assign(1, 0);
+    index.node.reserve(node.size());
+    index.id.reserve(node.size());
+    index.repeated.reserve(node.size());
+    index.bigrams.reserve(node.size());
+    index.groups.reserve(byLetters.size() / 2);
+    for(int i = 0; i < byLetters.size(); i++) {
+        uint32_t mask = byLetters[i].first, word = byLetters[i].second;
+        index.letters.insert(index.letters.end(), &letters[offset[word]], &letters[0] + offset[word + 1]);
+        index.offset.push_back(index.letters.size());
+        index.node.push_back(node[word]);
+        index.id.push_back(ids[word]);
+        index.repeated.push_back(repeated[word]);
+        index.bigrams.push_back(bigrams[word]);
 
-        if (l.row == n.row && l.col == n.col) lRepeatNum = repeats;
-        else if (board[n.row][n.col] == l.l && notRepeated(n, w)) repeats++;
+        if (i == 0 || byLetters[i-1].first != mask) index.groups[mask] = {i, i + 1};
+        else index.groups[mask].second = i + 1;
     }
+}
+
+// The reverse index of t, built the first time it is needed; after that
+// every search just reads it
+const ReverseIndex &reverseIndexOf(const Trie &t) {
+    ReverseIndexSlot &slot = *t.reverse;
+    call_once(slot.built, [&]() {
+        buildReverseIndex(slot.index, t);
+        slot.ready = true;
+    });
+    return slot.index;
+}
+
+// Finds the first path (in dfs order) that continues the current path, which
+// ends at cell, with w[i..n). On success the path is left on ctx's stack.
+bool matchFrom(SearchContext &ctx, const char *w, int n, int i, int cell) {
+    if (i == n) return true;
+    const Adjacency &adj = *ctx.adj;
+    for(unsigned dirs = adj.letterDirs[cell][w[i] - 'A']; dirs; dirs &= dirs - 1) {
+        int k = __builtin_ctz(dirs);
+        int next = adj.neighbors[cell][k];
+        if (!notRepeated(ctx, next)) continue;
 
-    return make_pair(repeats, lRepeatNum);
+        PathStep p = {(uint8_t) next, (adj.diagonalMask[cell] & cellBit(next)) != 0, 0, 0};
+        pair<int,int> r = repeats(ctx, cell, k);
+        p.repeat = r.first;
+        p.repeatNum = r.second;
+        int cChange = p.isDiag * diagComplexity + p.repeat * repeatComplexity;
+
+        pushStep(ctx, p, cChange);
+        if (matchFrom(ctx, w, n, i + 1, next)) return true;
+        popStep(ctx, cChange);
+    }
+    return false;
 }
 
-// Recurses through every possible word from a certain letter
-void dfs(word w, TrieNode* curr) {
-    if (addWord(w, curr)) curr->isWord = false; //prevents repeats
+// Letters on the board (bit l = 'A' + l), and those on more than one cell
+void boardLetters(const Adjacency &adj, uint32_t &present, uint32_t &repeated) {
+    present = repeated = 0;
+    for(int l = 0; l < 26; l++) {
+        int count = __builtin_popcountll(adj.letterMask[l]);
+        if (count > 0) present |= 1u << l;
+        if (count > 1) repeated |= 1u << l;
+    }
+}
 
-    letter last = w.path[w.path.size() - 1];
+void searchWordsReverse(Solver &s) {
+    const ReverseIndex &index = reverseIndexOf(*s.trie);
+    const Adjacency &adj = s.adj;
+    SearchContext &ctx = s.search;
+    attachSearch(s, ctx);
+    newSearchEpoch(ctx);
+    ctx.found = &s.found;
+    s.found.words.clear();
+    s.found.ids.clear();
+    s.matchKeys.clear();
 
-    for (pair<int,int> offset : directions) {
-        if (!inBounds(last, offset)) continue;
+    uint32_t present, repeated;
+    boardLetters(adj, present, repeated);
 
-        int r = last.row + offset.first; int c = last.col + offset.second;
-        letter l = {board[r][c], r, c, false, 0};
+    for(uint32_t subset = present; subset; subset = (subset - 1) & present) {
+        auto group = index.groups.find(subset);
+        if (group == index.groups.end()) continue;
+        for(uint32_t i = group->second.first; i < group->second.second; i++) {
+            if ((index.repeated[i] & ~repeated) || (index.bigrams[i] & ~adj.bigrams)) continue;
+            if (!(s.trie->lists[index.node[i]] & listWordBit(s.list))) continue;
+            PROFILE_COUNT(reverseCandidatesCounter);
+            const char *w = &index.letters[index.offset[i]];
+            int n = index.offset[i + 1] - index.offset[i];
 
-        if (notRepeated(l, w) && existsWord(l, curr)) {
-            l.isDiag = diagonal(l, w);
-            tie(l.repeat, l.repeatNum) = repeats(l, w);
-            int cChange = l.isDiag * diagComplexity + l.repeat * repeatComplexity;
+            for(CellMask starts = adj.letterMask[w[0] - 'A']; starts; starts &= starts - 1) {
+                int cell = __builtin_ctzll(starts);
+                ctx.state.depth = 0;
+                ctx.state.visited = 0;
+                ctx.state.complexity = baseComplexity;
+                pushStep(ctx, {(uint8_t) cell, false, 0, 0}, 0);
+                if (!matchFrom(ctx, w, n, 1, cell)) continue;
 
-            w.path.push_back(l);
-            w.complexity += cChange;
-            dfs(w, curr->children[l.l]);
-            w.path.pop_back();
-            w.complexity -= cChange;
+                // The dfs order key: start cell, then the direction of each step
+                string key(n, 0);
+                key[0] = cell;
+                for(int j = 1; j < n; j++) {
+                    int from = ctx.state.path[j-1].cell, k = 0;
+                    while(adj.neighbors[from][k] != ctx.state.path[j].cell) k++;
+                    key[j] = k;
+                }
+                addWord(ctx, index.node[i], index.id[i]);
+                s.matchKeys.push_back(move(key));
+                break;
+            }
         }
     }
+
+    // Put the words in dfs order
+    vector<int> &order = s.matchOrder;
+    order.resize(s.found.words.size());
+    for(int i = 0; i < order.size(); i++) order[i] = i;
+    sort(order.begin(), order.end(), [&](int a, int b) { return s.matchKeys[a] < s.matchKeys[b]; });
+    s.words.clear();
+    for(int i : order) s.words.push_back(move(s.found.words[i]));
 }
 
-// Starts a dfs at each of the 16 cells in the 4x4 board
-void searchWords() {
-    for(int r = 0; r < N; r++) {
-        for(int c = 0; c < N; c++) {
-            word w = {
-                vector<letter>(), baseComplexity, 0, false
-            };
-            letter l = {
-                board[r][c], r, c, false, 0
-            };
+/*
+Choosing an engine (--engine auto)
+The forward dfs costs about the number of board paths the trie lets it
+walk; the count of 3-letter paths that start a dictionary word stands in
+for that. The reverse search costs a lookup per subset of the board's
+letters plus a path check per candidate word. Both are in nanoseconds,
+measured on the benchmark boards (SolverBenchmark engines).
+The candidates are counted with the reverse index, which takes about as
+long to build as a hundred ordinary boards take to solve. Until it is
+built, each board where the reverse search might win (counting just its
+subset lookups) adds what it could have saved to the trie's forgone total,
+and goes forward; the index is built once that total pays for it. So a
+single board never waits for the index, but a run of boards with few
+distinct letters soon switches to the reverse search.
+*/
+const double forwardPathCost = 100;
+const double reverseSubsetCost = 35;
+const double reverseCandidateCost = 75;
+const double reverseIndexCost = 95e6;
 
-            w.path.push_back(l);
-            dfs(w, root.children[l.l]);
-            w.path.pop_back();
+// 3-letter paths on the board that start a dictionary word
+long long forwardPaths(const Solver &s) {
+    const Adjacency &adj = s.adj;
+    long long paths = 0;
+    for(int a = 0; a < adj.rows * adj.cols; a++) {
+        int na = trieChild(*s.trie, 0, adj.letters[a]);
+        if (na == -1) continue;
+        for(int i = 0; i < adj.neighborCount[a]; i++) {
+            int b = adj.neighbors[a][i];
+            int nb = trieChild(*s.trie, na, adj.letters[b]);
+            if (nb == -1) continue;
+            for(int j = 0; j < adj.neighborCount[b]; j++) {
+                int c = adj.neighbors[b][j];
+                if (c != a && trieChild(*s.trie, nb, adj.letters[c]) != -1) paths++;
+            }
         }
     }
+    return paths;
+}
+
+SearchEngine chooseEngine(const Solver &s) {
+    const Adjacency &adj = s.adj;
+    uint32_t present, repeated;
+    boardLetters(adj, present, repeated);
+    double reverse = reverseSubsetCost * (double) (1u << __builtin_popcount(present));
+
+    // Every 3-cell path bounds the forward cost from above; most boards with
+    // many distinct letters stop here, before walking the trie
+    long long cellPaths = 0;
+    for(int a = 0; a < adj.rows * adj.cols; a++) {
+        for(int i = 0; i < adj.neighborCount[a]; i++) cellPaths += adj.neighborCount[adj.neighbors[a][i]] - 1;
+    }
+    if (reverse >= forwardPathCost * cellPaths) return forwardEngine;
+
+    double forward = forwardPathCost * forwardPaths(s);
+    if (reverse >= forward) return forwardEngine; // no need to count the candidates
+
+    ReverseIndexSlot &slot = *s.trie->reverse;
+    if (!slot.ready && slot.forgone.fetch_add(forward - reverse) + (forward - reverse) < reverseIndexCost) {
+        return forwardEngine;
+    }
+    const ReverseIndex &index = reverseIndexOf(*s.trie);
+    for(uint32_t subset = present; subset && reverse < forward; subset = (subset - 1) & present) {
+        auto group = index.groups.find(subset);
+        if (group != index.groups.end()) reverse += reverseCandidateCost * (group->second.second - group->second.first);
+    }
+    return reverse < forward ? reverseEngine : forwardEngine;
+}
+
+// Fills the solver's words with every word on the board
+void searchWords(Solver &s) {
+    PROFILE_PHASE(searchPhase);
+    s.engineUsed = searchEngine == autoEngine ? chooseEngine(s) : searchEngine;
+    if (s.engineUsed == reverseEngine) searchWordsReverse(s);
+    else if (s.pool) searchWordsParallel(s, *s.pool);
+    else searchWordsSerial(s);
 }
 
 /*
@@ -236,138 +1391,1355 @@ The order that the words are printed out also greatly affects speed
 */
 
 // Returns the reward that a word gives
-int calculateReward(word &w) {
-    return points[w.path.size()];
+int calculateReward(const word &w) {
+    auto it = points.find(w.path.size());
+    return it == points.end() ? 0 : it->second;
 }
 
-// Chooses the best word to add based on the reward-to-complexity ratio
-word* findBestRatio() {
-    word* best;
-    double currRatio = 0;
+// The ratio heap
+// Unchosen words that give a reward, keyed by reward-to-complexity ratio;
+// ties go to the earlier word, as a linear scan with a strict > would pick.
+// Choosing a word only ever lowers other words' complexities, so keys only
+// grow: a word is re-keyed (and sifted up) only when its complexity changes,
+// and every other word keeps the key it had.
+double wordRatio(const word &w) {
+    return (double) calculateReward(w) / (w.complexity - w.complexityUpdate);
+}
 
-    for(int i = 0; i < words.size(); i++) {
-        word *w = &words[i];
-        if ((*w).chosen) continue;
-        double ratio = (double) calculateReward(*w) / ((*w).complexity - (*w).complexityUpdate);
+bool ratioBefore(const Solver &s, int a, int b) {
+    return s.ratios[a] > s.ratios[b] || (s.ratios[a] == s.ratios[b] && a < b);
+}
+
+void heapSwap(Solver &s, int i, int j) {
+    swap(s.ratioHeap[i], s.ratioHeap[j]);
+    s.heapPos[s.ratioHeap[i]] = i;
+    s.heapPos[s.ratioHeap[j]] = j;
+}
 
-        if (ratio > currRatio) {
-            currRatio = ratio;
-            best = w;
+void siftUp(Solver &s, int i) {
+    while(i > 0 && ratioBefore(s, s.ratioHeap[i], s.ratioHeap[(i - 1) / 2])) {
+        heapSwap(s, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+void siftDown(Solver &s, int i) {
+    int n = s.ratioHeap.size();
+    while(true) {
+        int best = i;
+        for(int c = 2*i + 1; c <= 2*i + 2 && c < n; c++) {
+            if (ratioBefore(s, s.ratioHeap[c], s.ratioHeap[best])) best = c;
         }
+        if (best == i) return;
+        heapSwap(s, i, best);
+        i = best;
     }
-    return best;
+}
+
+void buildRatioHeap(Solver &s) {
+    s.ratioHeap.clear();
+    s.heapPos.assign(s.words.size(), -1);
+    s.ratios.resize(s.words.size());
+    for(int i = 0; i < s.words.size(); i++) {
+        s.ratios[i] = wordRatio(s.words[i]);
+        if (s.words[i].chosen || s.ratios[i] <= 0) continue;
+        s.heapPos[i] = s.ratioHeap.size();
+        s.ratioHeap.push_back(i);
+    }
+    for(int i = (int) s.ratioHeap.size() / 2 - 1; i >= 0; i--) siftDown(s, i);
+}
+
+// Takes word i out of the heap
+void removeFromHeap(Solver &s, int i) {
+    int pos = s.heapPos[i];
+    heapSwap(s, pos, s.ratioHeap.size() - 1);
+    s.ratioHeap.pop_back();
+    s.heapPos[i] = -1;
+    if (pos < s.ratioHeap.size()) {
+        siftUp(s, pos);
+        siftDown(s, pos);
+    }
+}
+
+// Chooses the best word to add based on the reward-to-complexity ratio
+// returns nullptr if no word is left that gives any reward
+word* findBestRatio(Solver &s) {
+    if (s.ratioHeap.empty()) return nullptr;
+    return &s.words[s.ratioHeap[0]];
 }
 
 // Finds the similarity between two words (used to update complexity)
-int findSimilarity(word &a, word &b) {
+int findSimilarity(const word &a, const word &b) {
     int l = min(a.path.size(), b.path.size());
     int i = 0;
     while(i < l && a.path[i] == b.path[i]) i++;
     return i;
 }
 
-// Given that a word was added, set its complexity to INF
-// and update all other words (complexity of similar words
-// are reduced)
-void updateComplexities(word &w) {
-    for(int i = 0; i < words.size(); i++) {
-        word *w2 = &words[i];
-        int similarity = findSimilarity(*w2, w);
-        int update = similarityWorth[similarity];
+// Builds the prefix tree of the found words in one pass: consecutive words
+// share the prefixes up to their common length, and every deeper prefix of
+// the earlier word ends where the later word starts
+void buildPrefixTree(Solver &s) {
+    vector<PrefixNode> &nodes = s.prefixNodes;
+    vector<int> &open = s.openNodes; // prefixes of the previous word, by depth
+    nodes.assign(1, {0, -1, 0, (int) s.words.size()});
+    open.assign(1, 0);
+    s.wordNode.resize(s.words.size());
 
-        update = max(update, (*w2).complexityUpdate);
-        if ((*w2).complexity - update <= 0) update = (*w2).complexity - 1;
-        (*w2).complexityUpdate = update;
+    for(int i = 0; i < s.words.size(); i++) {
+        int shared = i > 0 ? findSimilarity(s.words[i-1], s.words[i]) : 0;
+        for(int d = open.size() - 1; d > shared; d--) nodes[open[d]].end = i;
+        open.resize(shared + 1);
+        for(int d = shared + 1; d <= s.words[i].path.size(); d++) {
+            nodes.push_back({d, open.back(), i, (int) s.words.size()});
+            open.push_back(nodes.size() - 1);
+        }
+        s.wordNode[i] = open.back();
     }
 }
 
-void orderOptimally() {
-    for(int i = 0; i < words.size(); i++) {
-        bool isChosen = false;
-        for(word w : chosenWords) {
-            if (words[i] == w) isChosen = true;
+// Relaxes word i toward the update given by a similarity of sim letters
+void relaxComplexity(Solver &s, int i, int sim) {
+    word *w2 = &s.words[i];
+    auto worth = similarityWorth.find(sim);
+    int update = worth == similarityWorth.end() ? 0 : worth->second;
+
+    update = max(update, (*w2).complexityUpdate);
+    if ((*w2).complexity - update <= 0) update = (*w2).complexity - 1;
+    if (update == (*w2).complexityUpdate) return;
+    (*w2).complexityUpdate = update;
+    if (s.heapPos[i] != -1) {
+        s.ratios[i] = wordRatio(*w2);
+        siftUp(s, s.heapPos[i]);
+    }
+}
+
+// Given that a word was added, update all other words (complexity of
+// similar words are reduced). Only words sharing at least minSimilarity
+// letters with it can change: those in the subtree of its prefix of that
+// length. Walking up its prefixes, the words under a prefix but not under
+// the next deeper one share exactly that many letters with it.
+void updateComplexities(Solver &s, word &w) {
+    static const int minSimilarity = []() {
+        for(auto &worth : similarityWorth) {
+            if (worth.second > 0) return worth.first;
         }
-        if (isChosen) filteredWords.push_back(words[i]);
+        return numeric_limits<int>::max();
+    }();
+
+    int node = s.wordNode[&w - &s.words[0]];
+    const PrefixNode &full = s.prefixNodes[node];
+    if (full.depth < minSimilarity) return;
+    for(int i = full.first; i < full.end; i++) relaxComplexity(s, i, full.depth);
+
+    for(int child = node; s.prefixNodes[child].depth > minSimilarity; child = s.prefixNodes[child].parent) {
+        const PrefixNode &inner = s.prefixNodes[child];
+        const PrefixNode &outer = s.prefixNodes[inner.parent];
+        for(int i = outer.first; i < inner.first; i++) relaxComplexity(s, i, outer.depth);
+        for(int i = inner.end; i < outer.end; i++) relaxComplexity(s, i, outer.depth);
+    }
+}
+
+// Lists the chosen words in dfs order, so words from the same start cell
+// (and sharing prefixes) are swiped one after another
+void orderOptimally(Solver &s) {
+    PROFILE_PHASE(orderPhase);
+    for(int i = 0; i < s.words.size(); i++) {
+        if (s.words[i].chosen) s.filteredWords.push_back(i);
     }
 }
 
 // Function to filter words. Repeatedly chooses the word with the
 // best reward-to-complexity ratio, and updates other words' complexities
-void chooseWords() {
+void chooseWords(Solver &s) {
+    PROFILE_PHASE(choosePhase);
     int complexityLeft = complexityBound;
+    buildRatioHeap(s);
+    buildPrefixTree(s);
 
     while(complexityLeft > 0) {
-        word* w = findBestRatio();
+        word* w = findBestRatio(s);
+        if (!w) break;
 
+        int i = w - &s.words[0];
+        removeFromHeap(s, i);
         (*w).chosen = true;
         complexityLeft -= ((*w).complexity - (*w).complexityUpdate);
-        chosenWords.push_back(*w);
-        updateComplexities(*w);
+        s.chosenWords.push_back(i);
+        updateComplexities(s, *w);
+    }
+}
+
+/*
+Exact selection (--exact)
+The greedy above is not always optimal. This finds the best selection for
+a cost model that matches how the words are swiped: in dfs order, each word
+costs its complexity minus the similarity worth of its common prefix with
+the word swiped just before it (clamped like complexityUpdate). The budget
+is complexityBound, or the greedy selection's cost if that is higher (the
+greedy may overshoot), so the greedy selection is always a candidate.
+
+It is a dp over the words in dfs order, on the prefix tree. For the word
+being added, an earlier word shares exactly d letters with it if the two
+meet at its depth-d prefix, so each prefix on the current path keeps the
+best selection ending in each complexity among the words that meet the
+current word there. When a prefix's subtree is finished, its table folds
+into its parent's. Each word costs O(length * budget).
+
+If the dp runs past its time budget, the greedy selection is kept.
+*/
+
+// What word w costs when swiped right after a word sharing shared letters
+int sequenceCost(const word &w, int shared) {
+    auto worth = similarityWorth.find(shared);
+    int update = worth == similarityWorth.end() ? 0 : worth->second;
+    return w.complexity - min(update, w.complexity - 1);
+}
+
+// Cost of the chosen words, swiped in dfs order
+int selectionCost(const Solver &s) {
+    int cost = 0, prev = -1;
+    for(int i = 0; i < s.words.size(); i++) {
+        if (!s.words[i].chosen) continue;
+        cost += sequenceCost(s.words[i], prev == -1 ? 0 : findSimilarity(s.words[prev], s.words[i]));
+        prev = i;
+    }
+    return cost;
+}
+
+void foldChainEnds(vector<ChainEnd> &into, const vector<ChainEnd> &from) {
+    for(int b = 0; b < into.size(); b++) {
+        if (from[b].reward > into[b].reward) into[b] = from[b];
+    }
+}
+
+// Runs after chooseWords; replaces the greedy selection if it finds a
+// better one within seconds. Returns false if it ran out of time.
+bool chooseWordsExact(Solver &s, double seconds) {
+    PROFILE_PHASE(exactPhase);
+    auto start = chrono::steady_clock::now();
+    s.greedyReward = 0;
+    for(int i : s.chosenWords) s.greedyReward += calculateReward(s.words[i]);
+    s.exactTimedOut = false;
+
+    int budget = max(complexityBound, selectionCost(s));
+    int width = budget + 1, n = s.words.size();
+    s.exactPrev.resize((size_t) n * width); // only read where written
+    vector<vector<ChainEnd>> &open = s.exactOpen; // open[d]: the current depth-d prefix
+    auto openLevel = [&](int d) {
+        if (open.size() <= d) open.resize(d + 1);
+        open[d].assign(width, {-1, -1});
+    };
+    openLevel(0);
+    open[0][0] = {0, -1};
+
+    int depth = 0;
+    for(int i = 0; i < n; i++) {
+        if (i % 64 == 0 && chrono::duration<double>(chrono::steady_clock::now() - start).count() > seconds) {
+            s.exactTimedOut = true;
+            return false;
+        }
+        const word &w = s.words[i];
+        int shared = i > 0 ? findSimilarity(s.words[i-1], w) : 0;
+        for(; depth > shared; depth--) foldChainEnds(open[depth - 1], open[depth]);
+        for(; depth < w.path.size(); depth++) openLevel(depth + 1);
+
+        // Chains ending in w: extend the best chain meeting w at each prefix
+        vector<ChainEnd> &own = open[depth];
+        int reward = calculateReward(w);
+        for(int d = 0; d < depth; d++) {
+            int cost = sequenceCost(w, d);
+            for(int b = 0; b + cost < width; b++) {
+                const ChainEnd &e = open[d][b];
+                if (e.reward < 0 || e.reward + reward <= own[b + cost].reward) continue;
+                own[b + cost] = {e.reward + reward, i};
+                s.exactPrev[(size_t) i * width + b + cost] = e.last;
+            }
+        }
+    }
+    for(; depth > 0; depth--) foldChainEnds(open[depth - 1], open[depth]);
+
+    int bestCost = 0;
+    for(int b = 0; b < width; b++) {
+        if (open[0][b].reward > open[0][bestCost].reward) bestCost = b;
+    }
+    if (open[0][bestCost].reward <= s.greedyReward) return true;
+
+    // Walk the best chain back and make it the selection
+    for(word &w : s.words) w.chosen = false;
+    s.chosenWords.clear();
+    for(int i = open[0][bestCost].last, b = bestCost; i != -1; ) {
+        int prev = s.exactPrev[(size_t) i * width + b];
+        s.words[i].chosen = true;
+        s.chosenWords.push_back(i);
+        b -= sequenceCost(s.words[i], prev == -1 ? 0 : findSimilarity(s.words[prev], s.words[i]));
+        i = prev;
+    }
+    reverse(s.chosenWords.begin(), s.chosenWords.end());
+    return true;
+}
+
+/*
+Result cache (--cache)
+Boards come back, often turned or mirrored, and none of a board's 8
+rotations and reflections changes which words it has. The cache keeps each
+solved board's words under its canonical form: the smallest of its 8
+orientations, written as rows separated by '/'.
+The same board in the same orientation gets its whole result back. In any
+other orientation the words are searched for again and chosen as usual: a
+turned path has the same diagonals and repeats, but the direction order
+(which path the dfs finds first, the word order, and the repeat colors) is
+not symmetric, so the paths must be redone. That dfs runs on a trie of just
+the cached words, so it skips every branch that leads to no word.
+With --cache-file the entries are also kept on disk: a header line naming
+the dictionary, then one line per entry with its key and words. New entries
+are appended; the file is rewritten with just the cached entries at startup
+and whenever it holds twice as many lines as the cache.
+*/
+ResultCache resultCache;
+const size_t defaultCacheEntries = 4096;
+
+// The board in orientation t (0-7): bit 2 transposes it, bit 1 mirrors the
+// rows and bit 0 the columns; rows are separated by '/'
+string orientBoard(const vector<vector<char>> &b, int t) {
+    int rows = b.size(), cols = b[0].size();
+    int outRows = (t & 4) ? cols : rows, outCols = (t & 4) ? rows : cols;
+    string out;
+    out.reserve(outRows * (outCols + 1));
+    for(int r = 0; r < outRows; r++) {
+        if (r > 0) out += '/';
+        for(int c = 0; c < outCols; c++) {
+            int i = (t & 4) ? c : r, j = (t & 4) ? r : c;
+            if (t & 2) i = rows - 1 - i;
+            if (t & 1) j = cols - 1 - j;
+            out += b[i][j];
+        }
+    }
+    return out;
+}
+
+string canonicalBoard(const vector<vector<char>> &b) {
+    string best = orientBoard(b, 0);
+    for(int t = 1; t < 8; t++) best = min(best, orientBoard(b, t));
+    return best;
+}
+
+// The cache key of s's board: its word list and canonical form
+string cacheKey(const Solver &s) {
+    return to_string(s.list) + ':' + canonicalBoard(s.board);
+}
+
+// Returns the entry for key, or null, counting a hit or a miss
+shared_ptr<const CacheEntry> findResult(ResultCache &cache, const string &key) {
+    lock_guard<mutex> lock(cache.m);
+    auto it = cache.entries.find(key);
+    if (it == cache.entries.end()) {
+        cache.misses++;
+        return nullptr;
+    }
+    cache.hits++;
+    cache.recent.splice(cache.recent.begin(), cache.recent, it->second);
+    return *it->second;
+}
+
+void writeCacheEntry(ostream &out, const CacheEntry &e) {
+    out << e.key;
+    if (!e.words.empty()) out << ' ' << e.words;
+    out << '\n';
+}
+
+// The cache file's first line: entries are only valid with the same dictionary
+string cacheFileHeader() {
+    string header = "wordhunt-cache 1 " + to_string(trie.wordCount) + " " + to_string(trie.nodeCount);
+    for(const Dictionary &d : dictionaries) header += " " + d.name;
+    return header;
+}
+
+// Rewrites the cache file with just the cached entries, oldest first, so it
+// does not grow without bound. The caller holds cache.m.
+bool writeCacheFile(ResultCache &cache) {
+    if (cache.file.is_open()) cache.file.close();
+    cache.file.open(cache.path, ios::trunc);
+    if (!cache.file) return false;
+    cache.file << cacheFileHeader() << '\n';
+    for(auto it = cache.recent.rbegin(); it != cache.recent.rend(); it++) writeCacheEntry(cache.file, **it);
+    cache.file.flush();
+    cache.fileEntries = cache.recent.size();
+    return true;
+}
+
+// Stores entry as the most recently used one, replacing any entry with its
+// key, and evicts the least recently used past capacity. The caller holds cache.m.
+void insertResult(ResultCache &cache, shared_ptr<const CacheEntry> entry) {
+    auto it = cache.entries.find(entry->key);
+    if (it != cache.entries.end()) cache.recent.erase(it->second);
+    cache.recent.push_front(entry);
+    cache.entries[entry->key] = cache.recent.begin();
+    while(cache.recent.size() > cache.capacity) {
+        cache.entries.erase(cache.recent.back()->key);
+        cache.recent.pop_back();
+    }
+}
+
+// Builds e's trie from its words
+void buildEntryTrie(CacheEntry &e) {
+    vector<string> ws;
+    for(size_t begin = 0; begin < e.words.size(); ) {
+        size_t end = min(e.words.find(' ', begin), e.words.size());
+        ws.push_back(e.words.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    sort(ws.begin(), ws.end());
+    ws.erase(unique(ws.begin(), ws.end()), ws.end());
+    e.trie = buildTrie(ws);
+    e.trie.neededStorage.assign(e.trie.nodeCount, 0);
+    e.trie.needed = e.trie.neededStorage.data();
+    singleWordList(e.trie);
+}
+
+// Caches s's result under key; board is its orientation. A new entry is
+// also appended to the cache file.
+void cacheResult(const Solver &s, const string &key, const string &board, bool isNew) {
+    shared_ptr<CacheEntry> e = make_shared<CacheEntry>();
+    e->key = key;
+    size_t letters = 0;
+    for(const word &w : s.words) letters += w.path.size();
+    e->words.reserve(letters + s.words.size());
+    e->steps.reserve(letters);
+    e->solved.reserve(s.words.size());
+    for(const word &w : s.words) {
+        if (!e->words.empty()) e->words += ' ';
+        for(const letter &l : w.path) {
+            e->words += l.l;
+            e->steps.push_back({(uint8_t) (l.row * s.adj.cols + l.col), l.isDiag, (uint8_t) l.repeat, (uint8_t) l.repeatNum});
+        }
+        e->solved.push_back({w.complexity, w.complexityUpdate, (uint8_t) w.path.size(), w.chosen});
+    }
+    buildEntryTrie(*e);
+    e->board = board;
+    e->chosenWords = s.chosenWords;
+    e->filteredWords = s.filteredWords;
+    e->greedyReward = s.greedyReward;
+    e->exactTimedOut = s.exactTimedOut;
+
+    lock_guard<mutex> lock(resultCache.m);
+    insertResult(resultCache, e);
+    if (isNew && resultCache.file.is_open()) {
+        if (++resultCache.fileEntries > 2 * resultCache.capacity) writeCacheFile(resultCache);
+        else writeCacheEntry(resultCache.file, *e);
+        resultCache.file.flush();
+    }
+}
+
+// Reads the cache file, if it was written for this dictionary, and rewrites
+// it with the entries that fit. Lines that do not parse are dropped.
+void loadResultCache(ResultCache &cache) {
+    ifstream in(cache.path);
+    string line;
+    if (getline(in, line) && line == cacheFileHeader()) {
+        while(getline(in, line)) {
+            shared_ptr<CacheEntry> e = make_shared<CacheEntry>();
+            bool valid = true;
+            size_t begin = 0;
+            while(begin < line.size()) {
+                size_t end = min(line.find(' ', begin), line.size());
+                string token = line.substr(begin, end - begin);
+                begin = end + 1;
+                if (e->key.empty()) {
+                    e->key = token;
+                    continue;
+                }
+                valid &= token.size() >= 3 && token.size() <= maxBoardCells;
+                for(char c : token) valid &= 'A' <= c && c <= 'Z';
+                if (!e->words.empty()) e->words += ' ';
+                e->words += token;
+            }
+            if (!valid || e->key.empty()) continue;
+            buildEntryTrie(*e);
+            insertResult(cache, e);
+        }
+    }
+    in.close();
+    if (!writeCacheFile(cache)) cerr << cache.path << ": could not write the cache file" << endl;
+}
+
+// Searches s's board for just the cached words, with the entry's trie: the
+// dfs takes the same steps as with the dictionary, minus the dead ends
+void searchCachedWords(Solver &s, const CacheEntry &e) {
+    PROFILE_PHASE(searchPhase);
+    SearchContext &ctx = s.cacheSearch;
+    ctx.trie = &e.trie;
+    ctx.adj = &s.adj;
+    ctx.list = 0;
+    searchEveryCell(s, ctx);
+}
+
+// Parts 3 and 4: finds, chooses and orders the words on s's board, through
+// the result cache if there is one
+void solveWords(Solver &s) {
+    shared_ptr<const CacheEntry> cached;
+    string key, board;
+    if (resultCache.capacity) {
+        key = cacheKey(s);
+        board = orientBoard(s.board, 0);
+        cached = findResult(resultCache, key);
+    }
+    if (cached && cached->board == board) {
+        // The entry was solved on this very board, so s.adj maps its steps back
+        s.words.clear();
+        s.words.reserve(cached->solved.size());
+        const PathStep *steps = cached->steps.data();
+        for(const CachedWord &c : cached->solved) {
+            s.words.push_back({{}, c.complexity, c.complexityUpdate, c.chosen});
+            stepLetters(s.adj, steps, c.length, s.words.back().path);
+            steps += c.length;
+        }
+        s.chosenWords = cached->chosenWords;
+        s.filteredWords = cached->filteredWords;
+        s.greedyReward = cached->greedyReward;
+        s.exactTimedOut = cached->exactTimedOut;
+        return;
     }
+
+    if (cached) searchCachedWords(s, *cached);
+    else searchWords(s);
+    chooseWords(s);
+    if (exactSeconds > 0) chooseWordsExact(s, exactSeconds);
+    orderOptimally(s);
+    // An entry read from the cache file gains this orientation's full result
+    if (resultCache.capacity && (!cached || cached->board.empty())) cacheResult(s, key, board, !cached);
+}
+
+void printCacheStats(ostream &out) {
+    if (!resultCache.capacity) return;
+    out << "cache: " << resultCache.hits << " hits, " << resultCache.misses << " misses, "
+        << resultCache.recent.size() << " entries" << endl;
 }
 
 /*
 Step 5:
 Prints the words
 Records stats of a board
+The printers append to s.output, which keeps its capacity from board to
+board, and printResults hands it to cout in one write
 */
-void printFilteredWords() {
+void renderWord(string &out, const word &w) {
+    if (plainOutput) {
+        for(const letter &l : w.path) out += l.l;
+        return;
+    }
+    for(const letter &l : w.path) {
+        out += letterColor(l);
+        out += l.l;
+        out += colorDefault;
+    }
+}
+
+void printFilteredWords(Solver &s) {
+    PROFILE_PHASE(printChosenPhase);
+    const vector<int> &filteredWords = s.filteredWords;
     for(int i = 0; i < filteredWords.size(); i++) {
-        if (i > 0 && !(filteredWords[i].path[0] == filteredWords[i-1].path[0])) cout << '\n';
-        cout << filteredWords[i] << '\n';
+        const word &w = s.words[filteredWords[i]];
+        if (i > 0 && !(w.path[0] == s.words[filteredWords[i-1]].path[0])) s.output += '\n';
+        renderWord(s.output, w);
+        s.output += '\n';
     }
-    cout << endl;
+    s.output += '\n';
 }
 
 bool compareByLength(const word &a, const word &b) {
     return a.path.size() > b.path.size();
 }
-void printAdditionalWords() {
-    vector<word> sortedWords(words.begin(), words.end());
-    sort(sortedWords.begin(), sortedWords.end(), compareByLength);
+// Sorts word indices the way sorting copies of the words would
+void printAdditionalWords(Solver &s) {
+    PROFILE_PHASE(printAllPhase);
+    s.sortedWords.resize(s.words.size());
+    for(int i = 0; i < s.words.size(); i++) s.sortedWords[i] = i;
+    sort(s.sortedWords.begin(), s.sortedWords.end(), [&](int a, int b) {
+        return compareByLength(s.words[a], s.words[b]);
+    });
 
-    for(word w: sortedWords) {
-        if (!w.chosen) cout << w << '\n';
+    for(int i : s.sortedWords) {
+        if (s.words[i].chosen) continue;
+        renderWord(s.output, s.words[i]);
+        s.output += '\n';
     }
 }
 
-WordListStats allWordsStats() {
-    WordListStats s = {0,0,0};
+void addWordStats(WordListStats &stats, const word &w) {
+    stats.numWords += 1;
+    stats.totalReward += calculateReward(w);
+    stats.totalComplexity += w.complexity;
+}
+void trackStats(Solver &s) {
+    PROFILE_PHASE(statsPhase);
+    WordListStats all = {0,0,0}, chosen = {0,0,0};
+    for(const word &w : s.words) addWordStats(all, w);
+    for(int i : s.filteredWords) addWordStats(chosen, s.words[i]);
 
-    for(word w : words) {
-        s.numWords += 1;
-        s.totalReward += calculateReward(w);
-        s.totalComplexity += w.complexity;
+    string &out = s.output;
+    out += "total reward: " + to_string(all.totalReward) + '\n';
+    out += "total words: " + to_string(all.numWords) + '\n';
+    out += "chosen reward: " + to_string(chosen.totalReward) + '\n';
+    out += "chosen words: " + to_string(chosen.numWords) + '\n';
+    if (s.greedyReward >= 0) {
+        out += "greedy reward: " + to_string(s.greedyReward);
+        if (s.exactTimedOut) out += " (exact selection ran out of time)";
+        else out += " (exact selection gains " + to_string(chosen.totalReward - s.greedyReward) + ")";
+        out += '\n';
     }
-    return s;
 }
-WordListStats chosenWordsStats() {
-    WordListStats s = {0,0,0};
 
-    for(word w : filteredWords) {
-        s.numWords += 1;
-        s.totalReward += calculateReward(w);
-        s.totalComplexity += w.complexity;
+// Part 5 in one go: the chosen words, the rest, then the stats
+void printResults(Solver &s, ostream &out) {
+    s.output.clear();
+    printFilteredWords(s);
+    printAdditionalWords(s);
+    trackStats(s);
+    out.write(s.output.data(), s.output.size());
+    out.flush();
+}
+
+/*
+Live mode (--live)
+Shows something useful before the board is solved: while the search runs,
+the most valuable words found so far are drawn as soon as they turn up,
+then the greedy list replaces them, then the exact list if --exact is on.
+Each draw moves the cursor back up over the previous one and overwrites it;
+with --plain, which writes no escape codes, it follows it after a blank line.
+The normal output follows once the final list is known.
+*/
+const int liveTopWords = 10;
+const int liveMaxWords = 20; // longer lists are cut, so a redraw fits on screen
+const double liveRedrawSeconds = 0.015; // while searching, at most this often
+
+double liveElapsed(const LiveView &view) {
+    return chrono::duration<double>(chrono::steady_clock::now() - view.start).count();
+}
+
+void startLive(LiveView &view, ostream &out) {
+    view.out = &out;
+    view.start = view.lastDraw = chrono::steady_clock::now();
+    view.lines = 0;
+    view.firstWordSeconds = view.finalSeconds = -1;
+}
+
+void clearLive(LiveView &view) {
+    if (view.lines > 0 && plainOutput) *view.out << '\n';
+    else if (view.lines > 0) *view.out << "\033[" << view.lines << "F\033[J";
+    view.lines = 0;
+}
+
+// Redraws the view as a heading and the words at the given indices
+void drawLive(LiveView &view, const vector<word> &words, const vector<int> &list, const string &heading) {
+    clearLive(view);
+    ostream &out = *view.out;
+    out << heading << " (" << (int) (liveElapsed(view) * 1000) << " ms)\n";
+    int shown = min((int) list.size(), liveMaxWords);
+    for(int i = 0; i < shown; i++) out << words[list[i]] << '\n';
+    view.lines = shown + 1;
+    if (shown < list.size()) {
+        out << "... " << list.size() - shown << " more\n";
+        view.lines++;
     }
-    return s;
+    out.flush();
+    view.lastDraw = chrono::steady_clock::now();
+    if (view.firstWordSeconds < 0 && !list.empty()) view.firstWordSeconds = liveElapsed(view);
 }
-void trackStats() {
-    WordListStats all = allWordsStats();
-    WordListStats chosen = chosenWordsStats();
 
-    cout << "total reward: " << all.totalReward << '\n';
-    cout << "total words: " << all.numWords << '\n';
-    cout << "chosen reward: " << chosen.totalReward << '\n';
-    cout << "chosen words: " << chosen.numWords << '\n';
+// The liveTopWords most rewarding words in words, earliest first on ties
+void topWords(const vector<word> &words, vector<int> &top) {
+    top.resize(words.size());
+    for(int i = 0; i < words.size(); i++) top[i] = i;
+    int k = min((int) top.size(), liveTopWords);
+    partial_sort(top.begin(), top.begin() + k, top.end(), [&](int a, int b) {
+        int ra = calculateReward(words[a]), rb = calculateReward(words[b]);
+        return ra != rb ? ra > rb : a < b;
+    });
+    top.resize(k);
 }
 
-int main() {
-    construct_trie(); //Part 1
-    inputBoard(); //Part 2
-    searchWords(); //Part 3
-    chooseWords(); // Part 4
-    orderOptimally();
-    printFilteredWords(); // Part 5
-    printAdditionalWords();
-    trackStats();
-}
\ No newline at end of file
+// Solves the board like the normal pipeline (search, chooseWords, the exact
+// selection if on, orderOptimally), drawing each stage's best words. The
+// search runs serially one start cell at a time so it can draw in between.
+void solveLive(Solver &s, LiveView &view) {
+    attachSearch(s, s.search);
+    newSearchEpoch(s.search);
+    s.search.found = &s.found;
+    s.found.words.clear();
+    s.found.ids.clear();
+
+    int cells = s.adj.rows * s.adj.cols;
+    size_t drawn = 0;
+    for(int cell = 0; cell < cells; cell++) {
+        searchFrom(s.search, cell, -1);
+        size_t found = s.found.words.size();
+        bool due = chrono::duration<double>(chrono::steady_clock::now() - view.lastDraw).count() >= liveRedrawSeconds;
+        if (found > drawn && (drawn == 0 || due)) {
+            topWords(s.found.words, view.shown);
+            drawLive(view, s.found.words, view.shown, "searching: " + to_string(found) + " words, " +
+                     to_string(cell + 1) + "/" + to_string(cells) + " cells");
+            drawn = found;
+        }
+    }
+    s.words.swap(s.found.words);
+
+    chooseWords(s);
+    view.shown = s.chosenWords;
+    sort(view.shown.begin(), view.shown.end());
+    drawLive(view, s.words, view.shown, "greedy selection: " + to_string(view.shown.size()) + " words");
+    if (exactSeconds > 0) {
+        chooseWordsExact(s, exactSeconds);
+        drawLive(view, s.words, s.chosenWords, "exact selection: " + to_string(s.chosenWords.size()) + " words");
+    }
+    orderOptimally(s);
+    clearLive(view);
+    view.finalSeconds = liveElapsed(view);
+}
+
+/*
+Batch mode
+Reads one board per line (the last token of the line, so "Board: ..." lines
+from Logs/results.txt work too) and writes one JSON record per board.
+Reading, solving, and writing run on separate threads connected by queues.
+Several solver threads, each with its own Solver, share the dictionary and
+solve boards concurrently; the writer puts records back in input order.
+*/
+
+// Returns an error message if b is not a valid board
+string checkBoard(const string &b) {
+    vector<string> rows;
+    return parseBoard(b, rows);
+}
+
+// Solves one board with the given solver
+BoardResult solveBoard(Solver &s, const string &request) {
+    BoardResult r;
+    r.board = request;
+    r.error = selectDictionary(s, r.board, r.dictionary);
+    if (r.error.empty()) r.error = checkBoard(r.board);
+    if (!r.error.empty()) return r;
+
+    setBoard(s, r.board);
+    clearWords(s);
+    solveWords(s);
+    r.words.swap(s.words);
+    r.chosen.swap(s.filteredWords);
+    r.greedyReward = s.greedyReward;
+    r.exactTimedOut = s.exactTimedOut;
+    return r;
+}
+
+void appendJsonString(string &out, const string &s) {
+    out += '"';
+    for(char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if ((unsigned char) c < 0x20) out += ' ';
+        else out += c;
+    }
+    out += '"';
+}
+
+void appendWord(string &out, const word &w) {
+    out += '"';
+    for(const letter &l : w.path) out += l.l;
+    out += '"';
+}
+
+// {"board":...,["dictionary":...,] (if the request named one) "words":N,"reward":R,"chosenWords":N,"chosenReward":R,
+//  ["greedyReward":R,"exactTimedOut":B,] (with --exact)
+//  "chosen":[...display order...],"all":[...dfs order...]}
+void appendResult(string &out, const BoardResult &r) {
+    PROFILE_PHASE(recordPhase);
+    out += "{\"board\":";
+    appendJsonString(out, r.board);
+    if (!r.dictionary.empty()) {
+        out += ",\"dictionary\":";
+        appendJsonString(out, r.dictionary);
+    }
+    if (!r.error.empty()) {
+        out += ",\"error\":";
+        appendJsonString(out, r.error);
+        out += "}\n";
+        return;
+    }
+
+    int reward = 0, chosenReward = 0;
+    for(const word &w : r.words) reward += calculateReward(w);
+    for(int i : r.chosen) chosenReward += calculateReward(r.words[i]);
+    out += ",\"words\":" + to_string(r.words.size()) + ",\"reward\":" + to_string(reward);
+    out += ",\"chosenWords\":" + to_string(r.chosen.size()) + ",\"chosenReward\":" + to_string(chosenReward);
+    if (r.greedyReward >= 0) {
+        out += ",\"greedyReward\":" + to_string(r.greedyReward);
+        out += string(",\"exactTimedOut\":") + (r.exactTimedOut ? "true" : "false");
+    }
+
+    out += ",\"chosen\":[";
+    for(int i = 0; i < r.chosen.size(); i++) {
+        if (i > 0) out += ',';
+        appendWord(out, r.words[r.chosen[i]]);
+    }
+    out += "],\"all\":[";
+    for(int i = 0; i < r.words.size(); i++) {
+        if (i > 0) out += ',';
+        appendWord(out, r.words[i]);
+    }
+    out += "]}\n";
+}
+
+// Solves every board in in on solverThreads solvers (0 = every core),
+// writing records to out in input order and a summary to cerr
+void runBatch(istream &in, ostream &out, int solverThreads) {
+    if (solverThreads <= 0) solverThreads = max(1u, thread::hardware_concurrency());
+    BlockingQueue<pair<long long,string>> boards(1024);
+    BlockingQueue<pair<long long,BoardResult>> results(1024);
+    auto start = chrono::steady_clock::now();
+
+    thread reader([&]() {
+        string line;
+        long long index = 0;
+        while(getline(in, line)) {
+            size_t end = line.find_last_not_of(" \t\r");
+            if (end == string::npos) continue;
+            size_t begin = line.find_last_of(" \t", end);
+            begin = (begin == string::npos) ? 0 : begin + 1;
+            boards.push({index++, line.substr(begin, end + 1 - begin)});
+        }
+        boards.close();
+    });
+
+    // Results arrive in completion order; hold the early ones back until
+    // every record before them has been written
+    long long solved = 0, failed = 0;
+    thread writer([&]() {
+        map<long long,BoardResult> pending;
+        pair<long long,BoardResult> r;
+        long long next = 0;
+        string record;
+        while(results.pop(r)) {
+            pending[r.first] = move(r.second);
+            for(auto it = pending.begin(); it != pending.end() && it->first == next; it = pending.erase(it), next++) {
+                record.clear();
+                appendResult(record, it->second);
+                out.write(record.data(), record.size());
+                if (it->second.error.empty()) solved++;
+                else failed++;
+            }
+        }
+        out.flush();
+    });
+
+    vector<thread> solvers;
+    for(int i = 0; i < solverThreads; i++) {
+        solvers.emplace_back([&]() {
+            Solver s;
+            s.trie = &trie;
+            pair<long long,string> b;
+            while(boards.pop(b)) results.push({b.first, solveBoard(s, b.second)});
+        });
+    }
+    for(thread &t : solvers) t.join();
+    results.close();
+    reader.join();
+    writer.join();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << "batch: " << solved << " boards solved";
+    if (failed) cerr << ", " << failed << " invalid";
+    cerr << " in " << seconds << " s (" << solved / seconds << " boards/s, "
+         << solverThreads << " solver thread(s))" << endl;
+    printCacheStats(cerr);
+}
+
+/*
+Server mode (--serve)
+Keeps the dictionary loaded and answers solve requests over a Unix domain
+socket, or a TCP port on localhost. A request is one line: a board string,
+as typed interactively (its shape gives the size, and "name:board" picks a
+dictionary). The response is one line with the board's batch mode record.
+Clients can pipeline: send many requests without waiting, and responses
+come back in request order.
+One thread runs an epoll event loop over the listening socket and every
+connection (all non-blocking). Complete lines go to a fixed pool of
+workers, each with its own Solver; finished responses come back through a
+queue, and an eventfd wakes the loop to write them out.
+A client that sends faster than it reads stops being read: at most
+maxInFlight of its requests are being solved or waiting to be sent, and
+none are read while more than maxQueuedOutput bytes wait for it. Full lines
+also wait in its input (blocked) while the job queue is full, as the loop
+never waits on the workers. A client whose answers still pile up past
+maxBufferedBytes is dropped.
+SIGINT and SIGTERM (read through a signalfd) stop the server: it finishes
+the requests already taken, sends what the clients will take, and removes
+its Unix socket.
+*/
+const size_t maxRequestBytes = 4096;
+const long long maxInFlight = 256;
+const size_t maxQueuedOutput = 1 << 16;
+const size_t maxBufferedBytes = 1 << 24;
+
+// Whether a --serve address is a TCP port rather than a Unix socket path
+bool isPortNumber(const string &address) {
+    return !address.empty() && address.find_first_not_of("0123456789") == string::npos;
+}
+
+// Removes the Unix socket at path left over from an earlier run. Returns
+// why path cannot be used instead, if it is not a socket or a server still
+// accepts on it (or "" if path is free)
+string clearSocketPath(const sockaddr_un &a) {
+    struct stat st;
+    if (lstat(a.sun_path, &st) == -1) return errno == ENOENT ? "" : strerror(errno);
+    if (!S_ISSOCK(st.st_mode)) return "address in use / not a socket";
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool live = probe != -1 && connect(probe, (const sockaddr*) &a, sizeof(a)) == 0;
+    if (probe != -1) close(probe);
+    if (live) return "address in use by a running server";
+    unlink(a.sun_path);
+    return "";
+}
+
+// Opens a listening socket on address: a port number (localhost TCP) or a
+// Unix socket path. Returns -1 (after printing why) on failure.
+int listenOn(const string &address) {
+    bool tcp = isPortNumber(address);
+    int fd = socket(tcp ? AF_INET : AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int bound = -1;
+    if (fd != -1 && tcp) {
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in a = {};
+        a.sin_family = AF_INET;
+        a.sin_port = htons(atoi(address.c_str()));
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bound = ::bind(fd, (sockaddr*) &a, sizeof(a));
+    }
+    else if (fd != -1 && address.size() < sizeof(sockaddr_un::sun_path)) {
+        sockaddr_un a = {};
+        a.sun_family = AF_UNIX;
+        strcpy(a.sun_path, address.c_str());
+        string why = clearSocketPath(a);
+        if (!why.empty()) {
+            cerr << address << ": could not listen (" << why << ")" << endl;
+            close(fd);
+            return -1;
+        }
+        bound = ::bind(fd, (sockaddr*) &a, sizeof(a));
+    }
+    if (bound == -1 || listen(fd, SOMAXCONN) == -1) {
+        cerr << address << ": could not listen (" << strerror(errno) << ")" << endl;
+        if (fd != -1) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Queues every finished response that is next in line on c, in request order
+void queueResponses(Connection &c) {
+    for(auto it = c.pending.begin(); it != c.pending.end() && it->first == c.nextResponse; it = c.pending.erase(it)) {
+        c.out += it->second;
+        c.pendingBytes -= it->second.size();
+        c.nextResponse++;
+    }
+}
+
+// Writes as much of c's output as the socket takes. Returns false if the
+// connection failed
+bool writeResponses(Connection &c) {
+    while(!c.out.empty()) {
+        ssize_t n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+        if (n == -1) return errno == EAGAIN || errno == EWOULDBLOCK;
+        c.out.erase(0, n);
+    }
+    return true;
+}
+
+// Hands c's full lines to the workers, as long as c has room for more
+// requests in flight and the job queue takes them; the rest stay in c.in.
+// Returns false if c sent a line that is too long
+bool dispatchRequests(Connection &c, uint64_t id, BlockingQueue<ServerJob> &jobs) {
+    size_t begin = 0, end;
+    while(c.nextRequest - c.nextResponse < maxInFlight && (end = c.in.find('\n', begin)) != string::npos) {
+        string line = c.in.substr(begin, end - begin);
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        line.erase(0, line.find_first_not_of(" \t"));
+        if (!line.empty()) {
+            ServerJob job = {id, c.nextRequest, move(line)};
+            if (!jobs.tryPush(job)) break;
+            c.nextRequest++;
+        }
+        begin = end + 1;
+    }
+    c.in.erase(0, begin);
+    c.blocked = c.in.find('\n') != string::npos;
+    return c.blocked || c.in.size() <= maxRequestBytes;
+}
+
+// Reads what c has sent (up to a buffer's worth past maxQueuedOutput, so a
+// fast sender cannot fill memory) and hands the full lines to the workers.
+// Returns false if the connection failed or sent a line that is too long
+bool readRequests(Connection &c, uint64_t id, BlockingQueue<ServerJob> &jobs) {
+    char buffer[16384];
+    while(c.in.size() < maxQueuedOutput) {
+        ssize_t n = recv(c.fd, buffer, sizeof(buffer), 0);
+        if (n == 0) {
+            // The last request may end without a newline, as in batch mode
+            size_t last = c.in.rfind('\n') + 1; // 0 if there is none
+            if (c.in.size() - last > maxRequestBytes) return false;
+            if (last < c.in.size()) c.in += '\n';
+            c.closing = true;
+            break;
+        }
+        if (n == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        c.in.append(buffer, n);
+    }
+    return dispatchRequests(c, id, jobs);
+}
+
+// Serves requests on address until SIGINT or SIGTERM, solving on workers
+// threads (0 = every core). Returns 1 if it could not start.
+int runServer(const string &address, int workers) {
+    if (workers <= 0) workers = max(1u, thread::hardware_concurrency());
+    int listener = listenOn(address);
+    if (listener == -1) return 1;
+    int wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int loop = epoll_create1(EPOLL_CLOEXEC);
+    // Blocked before the workers start, so they inherit the mask and the
+    // signals only ever arrive through stop
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+    int stop = signalfd(-1, &stopSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    // epoll data: 0 is the listener, 1 the eventfd, 2 the signalfd, anything
+    // else a connection id
+    auto watch = [&](int op, int fd, uint32_t events, uint64_t id) {
+        epoll_event e = {};
+        e.events = events;
+        e.data.u64 = id;
+        epoll_ctl(loop, op, fd, &e);
+    };
+    watch(EPOLL_CTL_ADD, listener, EPOLLIN, 0);
+    watch(EPOLL_CTL_ADD, wake, EPOLLIN, 1);
+    watch(EPOLL_CTL_ADD, stop, EPOLLIN, 2);
+
+    BlockingQueue<ServerJob> jobs(1024);
+    mutex doneMutex;
+    vector<ServerJob> done, finished;
+    vector<thread> pool;
+    for(int i = 0; i < workers; i++) {
+        pool.emplace_back([&]() {
+            Solver s;
+            s.trie = &trie;
+            ServerJob job;
+            while(jobs.pop(job)) {
+                BoardResult r = solveBoard(s, job.text);
+                job.text.clear();
+                appendResult(job.text, r);
+                {
+                    lock_guard<mutex> lock(doneMutex);
+                    done.push_back(move(job));
+                }
+                uint64_t one = 1;
+                if (write(wake, &one, sizeof(one)) == -1) {} // the loop wakes either way
+            }
+        });
+    }
+    cerr << "serving on " << address << " with " << workers << " worker(s)" << endl;
+
+    map<uint64_t,Connection> connections;
+    set<uint64_t> blocked; // connections with full lines left in their input
+    uint64_t nextId = 3;
+    // Closes a connection once it failed, or once the client is done sending
+    // and has every response. Otherwise waits for more requests (unless the
+    // client is done or has enough on its way) and for room to write (if
+    // there is output left).
+    auto settle = [&](uint64_t id, bool ok) {
+        Connection &c = connections[id];
+        if (c.out.size() + c.pendingBytes > maxBufferedBytes) ok = false; // not reading its answers
+        if (c.blocked) blocked.insert(id);
+        else blocked.erase(id);
+        if (ok && !(c.closing && !c.blocked && c.nextResponse == c.nextRequest && c.out.empty())) {
+            bool reading = !c.closing && !c.blocked && c.nextRequest - c.nextResponse < maxInFlight && c.out.size() < maxQueuedOutput;
+            watch(EPOLL_CTL_MOD, c.fd, (reading ? EPOLLIN : 0) | (c.out.empty() ? 0 : EPOLLOUT), id);
+            return;
+        }
+        close(c.fd); // also takes it out of the epoll set
+        connections.erase(id);
+        blocked.erase(id);
+    };
+    // Takes the responses the workers have finished, in request order per
+    // connection, and notes which connections got any
+    set<uint64_t> touched;
+    auto collect = [&]() {
+        {
+            lock_guard<mutex> lock(doneMutex);
+            finished.swap(done);
+        }
+        for(ServerJob &job : finished) {
+            auto c = connections.find(job.connection);
+            if (c == connections.end()) continue; // closed meanwhile
+            c->second.pendingBytes += job.text.size();
+            c->second.pending[job.number] = move(job.text);
+            queueResponses(c->second);
+            touched.insert(job.connection);
+        }
+        finished.clear();
+    };
+
+    epoll_event events[64];
+    bool stopping = false;
+    while(!stopping) {
+        int n = epoll_wait(loop, events, 64, -1);
+        for(int i = 0; i < n; i++) {
+            uint64_t id = events[i].data.u64;
+            if (id == 0) {
+                int fd;
+                while((fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+                    connections[nextId].fd = fd;
+                    watch(EPOLL_CTL_ADD, fd, EPOLLIN, nextId++);
+                }
+            }
+            else if (id == 1) {
+                uint64_t count;
+                if (read(wake, &count, sizeof(count)) == -1) {} // only clears the counter
+                collect();
+                // Each job taken left room in the queue, and each response
+                // room in flight, so the blocked connections can go on
+                touched.insert(blocked.begin(), blocked.end());
+                for(uint64_t t : touched) {
+                    auto c = connections.find(t);
+                    if (c == connections.end()) continue;
+                    bool ok = !c->second.blocked || dispatchRequests(c->second, t, jobs);
+                    settle(t, ok && writeResponses(c->second));
+                }
+                touched.clear();
+            }
+            else if (id == 2) {
+                signalfd_siginfo info;
+                if (read(stop, &info, sizeof(info)) == -1) {} // consumed, so it is not delivered later
+                stopping = true;
+            }
+            else {
+                auto c = connections.find(id);
+                if (c == connections.end()) continue;
+                // A hangup means the client is gone both ways, with no one left to answer
+                bool ok = !(events[i].events & (EPOLLERR | EPOLLHUP));
+                if (ok && (events[i].events & EPOLLIN)) ok = readRequests(c->second, id, jobs);
+                if (ok && (events[i].events & EPOLLOUT)) ok = writeResponses(c->second);
+                settle(id, ok);
+            }
+        }
+    }
+
+    cerr << "server: stopping" << endl;
+    close(listener);
+    if (!isPortNumber(address)) unlink(address.c_str());
+    jobs.close();
+    for(thread &t : pool) t.join();
+    collect();
+    for(auto &c : connections) {
+        writeResponses(c.second); // whatever the socket takes without waiting
+        close(c.second.fd);
+    }
+    close(stop);
+    close(wake);
+    close(loop);
+    return 0;
+}
+
+#ifdef WORDHUNT_PROFILE
+// Writes the profile of the run so far (see Profiling) as one JSON object
+void writeProfile(ostream &out, double seconds) {
+    ProfileCounts total = {};
+    {
+        lock_guard<mutex> lock(profileMutex);
+        addProfile(total, retiredProfile);
+        for(ProfileCounts *p : threadProfiles) addProfile(total, *p);
+    }
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    out << "{\"compiler\":\"" << __VERSION__ << "\",\"wallSeconds\":" << seconds << ",\"phases\":{";
+    for(int i = 0; i < phaseCount; i++) {
+        const PhaseStats &p = total.phases[i];
+        out << (i > 0 ? "," : "") << '"' << phaseNames[i] << "\":{\"calls\":" << p.calls
+            << ",\"totalMs\":" << p.nanoseconds / 1e6 << ",\"meanUs\":" << (p.calls ? p.nanoseconds / 1e3 / p.calls : 0)
+            << ",\"maxUs\":" << p.maxNanoseconds / 1e3 << '}';
+    }
+    out << "},\"counters\":{";
+    for(int i = 0; i < counterCount; i++) {
+        out << (i > 0 ? "," : "") << '"' << counterNames[i] << "\":" << total.counters[i];
+    }
+    out << "},\"dictionaryNodes\":" << trie.nodeCount << ",\"dictionaryWords\":" << trie.wordCount;
+    if (resultCache.capacity) out << ",\"cacheHits\":" << resultCache.hits << ",\"cacheMisses\":" << resultCache.misses;
+#ifndef WORDHUNT_NO_MAIN
+    out << ",\"allocations\":" << allocations << ",\"allocatedBytes\":" << allocatedBytes;
+#endif
+    out << ",\"peakRssKiB\":" << usage.ru_maxrss << "}" << endl;
+}
+#endif
+
+#ifndef WORDHUNT_NO_MAIN
+int main(int argc, char **argv) {
+    // FinalWordHuntSolver --compile-dictionary [dictionary.txt] [dictionary.bin]
+    // FinalWordHuntSolver --embed-dictionary [dictionary.txt] [EmbeddedDictionary.h]
+    if (argc > 1 && string(argv[1]) == "--compile-dictionary") {
+        return compileDictionary(argc > 2 ? argv[2] : dictionaryTextPath,
+                                 argc > 3 ? argv[3] : dictionaryImagePath, false);
+    }
+    if (argc > 1 && string(argv[1]) == "--embed-dictionary") {
+        return compileDictionary(argc > 2 ? argv[2] : dictionaryTextPath,
+                                 argc > 3 ? argv[3] : embeddedDictionaryPath, true);
+    }
+
+    // --threads [count]: parallel search, or in batch mode that many boards
+    // solved at once (count 0 or omitted = every core)
+    // --batch [boards.txt]: solve one board per line (stdin if no file), see runBatch
+    // --exact [ms]: also run the exact selection, within ms per board (default 50)
+    // --live: draw the best words found so far while solving, see solveLive
+    // --engine forward|reverse|auto: how to find the words (default auto), see Reverse search
+    // --dictionary name=path: load a word list (repeat for more), see Dictionary registry
+    // --serve [port or socket path]: answer requests until stopped (default
+    // /tmp/wordhunt.sock), with --threads workers, see Server mode
+    // --cache [entries]: reuse the results of boards seen before, in any
+    // orientation (default 4096 entries), see Result cache
+    // --cache-file path: keep the cache in a file across runs (implies --cache)
+    // --profile [file.json]: when done, write where the time went (stderr if no
+    // file); needs a build with -DWORDHUNT_PROFILE, see Profiling
+    bool batch = false, live = false, serve = false;
+    string batchPath, serveAddress = "/tmp/wordhunt.sock";
+    int threads = 1;
+#ifdef WORDHUNT_PROFILE
+    bool profile = false;
+    string profilePath;
+    auto start = chrono::steady_clock::now();
+#endif
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc && argv[i + 1][0] != '-';
+        if (arg == "--threads") {
+            threads = hasValue ? atoi(argv[++i]) : 0;
+        }
+        else if (arg == "--exact") {
+            exactSeconds = (hasValue ? atof(argv[++i]) : 50) / 1000;
+        }
+        else if (arg == "--engine" && hasValue) {
+            string engine = argv[++i];
+            if (engine == "forward") searchEngine = forwardEngine;
+            else if (engine == "reverse") searchEngine = reverseEngine;
+            else if (engine == "auto") searchEngine = autoEngine;
+            else {
+                cerr << "unknown engine " << engine << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--dictionary" && hasValue) {
+            string spec = argv[++i];
+            size_t eq = spec.find('=');
+            if (eq == string::npos || eq == 0 || spec.find(':') < eq) {
+                cerr << "expected --dictionary name=path" << endl;
+                return 1;
+            }
+            string name = spec.substr(0, eq);
+            if (findDictionary(name) != -1 || dictionaries.size() == maxWordLists) {
+                cerr << "dictionary " << name << (dictionaries.size() == maxWordLists ? ": too many dictionaries" : " given twice") << endl;
+                return 1;
+            }
+            dictionaries.push_back({name, spec.substr(eq + 1)});
+        }
+        else if (arg == "--cache") {
+            resultCache.capacity = hasValue ? atoll(argv[++i]) : defaultCacheEntries;
+        }
+        else if (arg == "--cache-file" && hasValue) {
+            resultCache.path = argv[++i];
+            if (!resultCache.capacity) resultCache.capacity = defaultCacheEntries;
+        }
+        else if (arg == "--profile") {
+#ifdef WORDHUNT_PROFILE
+            profile = true;
+            if (hasValue) profilePath = argv[++i];
+#else
+            cerr << "--profile needs a build with -DWORDHUNT_PROFILE" << endl;
+            return 1;
+#endif
+        }
+        else if (arg == "--live") {
+            live = true;
+        }
+        else if (arg == "--plain") {
+            plainOutput = true;
+        }
+        else if (arg == "--serve") {
+            serve = true;
+            if (hasValue) serveAddress = argv[++i];
+        }
+        else if (arg == "--batch") {
+            batch = true;
+            if (hasValue) batchPath = argv[++i];
+        }
+        else {
+            cerr << "unknown option " << arg << endl;
+            return 1;
+        }
+    }
+
+    // Writes the profile, if asked for, and returns code
+    auto finish = [&](int code) {
+#ifdef WORDHUNT_PROFILE
+        if (profile) {
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            ofstream file;
+            if (!profilePath.empty()) file.open(profilePath);
+            writeProfile(profilePath.empty() ? cerr : file, seconds);
+        }
+#endif
+        return code;
+    };
+
+    if (dictionaries.empty() ? !construct_trie() : !loadDictionaries()) return 1; //Part 1
+    if (!resultCache.path.empty()) loadResultCache(resultCache);
+    if (serve) return finish(runServer(serveAddress, threads));
+    if (batch) {
+        if (batchPath.empty()) {
+            runBatch(cin, cout, threads);
+            return finish(0);
+        }
+        ifstream boardsFile(batchPath);
+        if (!boardsFile) {
+            cerr << batchPath << ": could not open boards file" << endl;
+            return 1;
+        }
+        runBatch(boardsFile, cout, threads);
+        return finish(0);
+    }
+
+    unique_ptr<ThreadPool> pool(threads != 1 ? new ThreadPool(threads) : nullptr);
+    Solver s;
+    s.trie = &trie;
+    s.pool = pool.get();
+
+    LiveView view;
+    while(inputBoard(s)) { //Part 2
+        clearWords(s);
+        if (live) {
+            startLive(view, cout);
+            solveLive(s, view); // Parts 3 and 4, drawn as they go
+        }
+        else {
+            solveWords(s); // Parts 3 and 4
+        }
+        printResults(s, cout); // Part 5
+        if (live) {
+            cout << "first word after " << view.firstWordSeconds * 1000 << " ms, final list after "
+                 << view.finalSeconds * 1000 << " ms" << endl;
+        }
+    }
+    printCacheStats(cerr);
+    return finish(0);
+}
+#endif
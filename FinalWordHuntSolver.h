@@ -7,16 +7,13 @@ using namespace std;
 
 // Printing Colors
 // colors from: https://gist.github.com/Kielx/2917687bc30f567d45e15a4577772b02
-map<string,string> colors = {
-    {"default", "\033[37m"}, //white but not bold
-    {"white", "\033[1m\033[37m"},
-    {"black", "\033[1;30m"},
-    {"purple", "\033[1;35m"},
-    {"yellow", "\033[1;33m"},
-    {"blue","\033[1;34m" },
-    {"green","\033[1;32m"},
-    {"red","\033[1;31m"}
-};
+// Kept as constants so printing a letter never looks a color up by name;
+// only the ones the printers emit
+const string colorDefault = "\033[37m"; //white but not bold
+const string colorWhite = "\033[1m\033[37m";
+const string colorBlue = "\033[1;34m";
+const string colorRed = "\033[1;31m";
+bool plainOutput = false; // --plain: print words without colors
 
 // Letter
 struct letter {
@@ -27,13 +24,15 @@ struct letter {
     int repeat;
     int repeatNum;
 };
-ostream& operator<<(ostream &os, const letter&l) {
-    string color = "white";
+const string &letterColor(const letter &l) {
     if (l.repeat) {
-        color = (l.repeatNum == 0) ? "blue" : "red";
+        return (l.repeatNum == 0) ? colorBlue : colorRed;
     }
-    // else if (l.isDiag) color = "purple";
-    return os << colors[color] << l.l << colors["default"];
+    return colorWhite;
+}
+ostream& operator<<(ostream &os, const letter&l) {
+    if (plainOutput) return os << l.l;
+    return os << letterColor(l) << l.l << colorDefault;
 }
 bool operator==(const letter& la, const letter& lb)
 {
@@ -53,15 +52,389 @@ ostream& operator<<(ostream &os, const word& w) {
     }
     return os;
 }
-bool operator==(word &a, word &b) {
+bool operator==(const word &a, const word &b) {
     return a.path == b.path;
 }
 
+// SearchState
+// The path the dfs is currently on, kept in place so the search never allocates.
+// Each step is just its cell (row*cols + col) and the complexity info of the
+// move onto it; the letters are only built when a word is found.
+// visited has the bit of every cell on the path set.
+typedef uint64_t CellMask;
+const int maxBoardCells = 8 * sizeof(CellMask);
+
+constexpr CellMask cellBit(int cell) {
+    return (CellMask) 1 << cell;
+}
+
+struct PathStep {
+    uint8_t cell;
+    bool isDiag;
+    uint8_t repeat;
+    uint8_t repeatNum;
+};
+
+struct SearchState {
+    PathStep path[maxBoardCells];
+    int depth;
+    int complexity;
+    CellMask visited;
+};
+
+// FoundWords
+// Words found by one search, in dfs order, with each one's word id
+struct FoundWords {
+    vector<word> words;
+    vector<int> ids;
+};
+
+// SearchContext
+// Everything one thread needs to run the dfs: its current path, where found
+// words go, and its duplicate suppression. A word's id (see TrieNode) is
+// stamped with the current epoch when it is found, so the trie stays untouched.
+struct Trie;
+struct Adjacency;
+struct SearchContext {
+    const Trie *trie; // dictionary and board the search runs on
+    const Adjacency *adj;
+    int list; // the trie's word list to search (see Word lists)
+    SearchState state;
+    FoundWords *found;
+    vector<uint32_t> foundEpoch;
+    uint32_t epoch = 0;
+};
+
+// Adjacency
+// Neighbor tables (bitboards, one bit per cell) for one board, built once per
+// board so the dfs never checks bounds. neighbors[cell] lists a cell's in-bounds
+// neighbors (never holes) in directions order, and before[cell][k] masks the
+// neighbors listed ahead of the k-th one. letterNeighbors[cell][l] masks the
+// neighbors of cell that hold letter 'A' + l; neighborLetters[cell] has bit l
+// set if there is one, and letterDirs[cell][l] has bit k set if the k-th is one.
+// bigrams is the signature (see bigramBit) of every pair of letters (a, b)
+// where a cell with a borders one with b. shape picks the search compiled for
+// the board (see Board shapes).
+enum BoardShape { anyShape, shape4x4, shape5x5 };
+
+struct Adjacency {
+    int rows;
+    int cols;
+    CellMask valid; // cells that hold a letter (the rest are holes)
+    char letters[maxBoardCells];
+    int neighborCount[maxBoardCells];
+    uint8_t neighbors[maxBoardCells][8];
+    CellMask diagonalMask[maxBoardCells];
+    CellMask before[maxBoardCells][8];
+    CellMask letterMask[26];
+    CellMask letterNeighbors[maxBoardCells][26];
+    uint32_t neighborLetters[maxBoardCells];
+    uint8_t letterDirs[maxBoardCells][26];
+    uint64_t bigrams;
+    uint64_t missingBigrams; // ~bigrams, or 0 with bigram pruning off
+    BoardShape shape;
+};
+
+// Bigram signatures
+// A set of letter pairs (bigrams) folded into 64 bits: pair (a, b) sets bit
+// (26a + b) % 64. A bit missing from a board's signature means no pair that
+// maps to it borders anywhere on the board.
+inline uint64_t bigramBit(int a, int b) {
+    return (uint64_t) 1 << ((a * 26 + b) % 64);
+}
+
 // TrieNode
+// All nodes live in one contiguous array (Trie::nodes) and refer to each other
+// by index. Bits 0-25 of mask mark which letters A-Z have a child, and bit 26
+// marks the end of a word. A node's children are stored next to each other,
+// so the child for letter c is at firstChild + (number of mask bits below c).
+// The dictionary is minimized into a DAWG (see minimizeTrie): nodes with the
+// same words below them share one block of children, so a node no longer
+// stands for a single prefix. Words are told apart by their word id, their
+// index in the sorted word list: the id of a prefix is the sum of
+// wordsBefore along its path (the words that sort between the parent's
+// prefix and this node's), and a word's id is the id of its prefix.
+const uint32_t letterBits = (1u << 26) - 1;
+const uint32_t isWordBit = 1u << 26;
+
 struct TrieNode {
-    map<char, TrieNode*> children;
-    bool isWord;
+    uint32_t mask;
+    uint32_t firstChild;
+    uint32_t wordsBefore;
+};
+
+// ReverseIndex
+// The dictionary's words (3 letters or more) for the reverse search, grouped
+// by the set of letters they use: groups maps a letter set (bit l = 'A' + l)
+// to the range of words using exactly those letters. For each word it keeps
+// the letters used more than once and a 64-bit signature of its bigrams.
+struct ReverseIndex {
+    vector<char> letters; // word i is letters[offset[i], offset[i+1])
+    vector<uint32_t> offset;
+    vector<uint32_t> node; // the word's trie node
+    vector<uint32_t> id;
+    vector<uint32_t> repeated;
+    vector<uint64_t> bigrams;
+    unordered_map<uint32_t, pair<uint32_t,uint32_t>> groups;
+};
+
+// The reverse index of one trie: the first search that needs it builds it
+// (see reverseIndexOf), and every later one only reads it. Until then,
+// forgone adds up what the reverse search could have saved (see chooseEngine).
+struct ReverseIndexSlot {
+    once_flag built;
+    atomic<bool> ready{false};
+    atomic<long long> forgone{0}; // nanoseconds
+    ReverseIndex index;
+};
+
+struct Trie {
+    const TrieNode *nodes = nullptr; // nodes[0] is the root
+    uint32_t nodeCount = 0;
+    uint32_t wordCount = 0;
+    // needed[node]: signature of the bigrams that every word below node
+    // still has to spell after reaching it (0 if node ends a word)
+    const uint64_t *needed = nullptr;
+    const uint32_t *lists = nullptr; // see Word lists
+    // Own nodes, needed and lists when they were built here rather than
+    // mapped from a dictionary image or embedded
+    vector<TrieNode> storage;
+    vector<uint64_t> neededStorage;
+    vector<uint32_t> listStorage;
+    unique_ptr<ReverseIndexSlot> reverse{new ReverseIndexSlot()};
+};
+
+// Word lists
+// A trie can hold several word lists (dictionaries) at once, minimized
+// together so the words and endings they share are stored once. lists[node]
+// has bit i set if the node ends a word of list i, and bit 16 + i if list i
+// has a word at or below the node, so a search of list i skips the rest.
+const int maxWordLists = 16;
+
+inline uint32_t listWordBit(int list) {
+    return 1u << list;
+}
+
+inline uint32_t listReachBit(int list) {
+    return 1u << (16 + list);
+}
+
+// Dictionary
+// A word list in the registry (--dictionary name=path); its index in the
+// registry is its list in the shared trie
+struct Dictionary {
+    string name;
+    string path;
+};
+
+// Search engines: walk the board with the trie, match the dictionary
+// against the board, or let a cost model pick per board
+enum SearchEngine { autoEngine, forwardEngine, reverseEngine };
+
+// Dictionary image
+// A compiled dictionary on disk: this header followed by the trie's needed
+// signatures, its node array and its lists, nodeCount of each, so nothing is
+// computed at startup. Nodes only refer to each other by index, so the file
+// can be mapped anywhere and searched in place. The checksum covers the
+// header and all three arrays. The size and modification time of the text dictionary it was
+// compiled from tell when it is out of date.
+const char dictionaryMagic[8] = {'W','H','D','I','C','T','\0','\0'};
+const uint32_t dictionaryVersion = 4; // 2: DAWG nodes with wordsBefore, 3: source stamp, 4: needed and lists
+
+struct DictionaryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t wordCount;
+    uint32_t checksum;
+    uint64_t sourceSize;
+    int64_t sourceModified; // seconds since the epoch
+};
+
+// Returns the index of l's child under node, or -1 if there is none
+inline int trieChild(const Trie &t, int node, char l) {
+    if (l < 'A' || l > 'Z') return -1;
+    uint32_t bit = 1u << (l - 'A');
+    const TrieNode &n = t.nodes[node];
+    if (!(n.mask & bit)) return -1;
+    return n.firstChild + __builtin_popcount(n.mask & (bit - 1));
+}
+
+// PrefixNode
+// A path prefix shared by found words. The dfs finds every word that starts
+// with a given path while it is inside that path's subtree, so those words
+// are contiguous in dfs order: words [first, end) start with this prefix.
+struct PrefixNode {
+    int depth; // letters in the prefix
+    int parent;
+    int first, end;
+};
+
+// ChainEnd
+// Best selection (in dfs order) found so far for some complexity: its reward
+// and its last word
+struct ChainEnd {
+    int reward; // -1 if no selection has this complexity
+    int last; // -1 for the empty selection
+};
+
+// LiveView
+// The part of the terminal live mode redraws in place, and how long the
+// current board took to show its first word and its final list
+struct LiveView {
+    ostream *out;
+    chrono::steady_clock::time_point start, lastDraw;
+    int lines; // lines drawn so far, erased by the next draw
+    double firstWordSeconds; // -1 until a word is shown
+    double finalSeconds;
+    vector<int> shown; // word indices being shown
+};
+
+// Result of one board in batch mode
+struct BoardResult {
+    string board;
+    string dictionary; // as named in the request, empty for the default
+    string error; // empty if the board was solved
+    vector<word> words; // all words, in dfs order
+    vector<int> chosen; // indices of the chosen words, in display order
+    int greedyReward = -1; // with --exact: reward of the greedy selection
+    bool exactTimedOut = false;
+};
+
+// Connection
+// One client of server mode. Requests are numbered in the order they arrive
+// and answered in that order, however the workers finish them.
+struct Connection {
+    int fd;
+    string in; // bytes read that do not make a full line yet
+    string out; // responses not yet written
+    long long nextRequest = 0; // number of the next request read
+    long long nextResponse = 0; // number of the next response to queue in out
+    map<long long,string> pending; // responses finished ahead of nextResponse
+    size_t pendingBytes = 0; // total size of pending
+    bool blocked = false; // in holds full lines the workers had no room for yet
+    bool closing = false; // the client is done sending: close once all is answered
+};
+
+// ServerJob
+// A request handed to server mode's workers, and later its response
+struct ServerJob {
+    uint64_t connection; // id, as connections come and go
+    long long number;
+    string text; // the request line, then the response
+};
+
+// CacheEntry
+// A solved board in the result cache (--cache), stored under the canonical
+// form of the board (see canonicalBoard). Its words hold on any rotation or
+// mirror image of the board; the rest is the full result for board, the
+// orientation it was solved in (none if read from the cache file). Only
+// what rebuilds the printers' words is kept: each solved word's steps (its
+// letters are those in words, in the same order) and a CachedWord.
+struct CachedWord {
+    int complexity;
+    int complexityUpdate;
+    uint8_t length; // steps in its path
+    bool chosen;
+};
+
+struct CacheEntry {
+    string key;
+    string words; // separated by spaces, as in the cache file
+    Trie trie; // of words, to find their paths in another orientation
+    string board;
+    vector<PathStep> steps; // every solved word's path, one after another
+    vector<CachedWord> solved; // in dfs order
+    vector<int> chosenWords, filteredWords;
+    int greedyReward;
+    bool exactTimedOut;
+};
+
+// ResultCache
+// Least recently used entries are evicted past capacity. Entries are never
+// changed once stored, so a solver keeps using one after it is evicted.
+struct ResultCache {
+    size_t capacity = 0; // 0: no cache
+    string path; // the cache file, empty if the cache is not kept on disk
+    ofstream file; // new entries are appended here
+    size_t fileEntries = 0; // entries in the file, evicted ones included
+    mutex m;
+    list<shared_ptr<const CacheEntry>> recent; // most recently used first
+    unordered_map<string, list<shared_ptr<const CacheEntry>>::iterator> entries;
+    long long hits = 0, misses = 0;
+};
+
+// Solver
+// Everything one board's solve reads and writes. The dictionary is shared
+// and read-only, so separate Solvers can run on separate threads at once.
+class ThreadPool;
+struct Solver {
+    const Trie *trie;
+    int list = 0; // the trie's word list this board is solved with
+    ThreadPool *pool = nullptr; // splits this solver's search, if set
+
+    vector<vector<char>> board;
+    Adjacency adj; // neighbor tables for board
+    vector<word> words; // all possible words
+    // The selection refers to words by index, so no path is ever copied
+    vector<int> chosenWords; // the subset of words we choose
+    vector<int> filteredWords; //chosenWords but in optimal order
+    vector<int> sortedWords; // all words, longest first, for printing
+    string output; // the printed result, rendered before one write (see printResults)
+
+    // Selection: max-heap of word indices by reward-to-complexity ratio.
+    // heapPos[i] is word i's slot in ratioHeap, or -1 once it is out.
+    vector<int> ratioHeap;
+    vector<int> heapPos;
+    vector<double> ratios;
+
+    // Prefix tree of the found words' paths; wordNode[i] is word i's full path
+    vector<PrefixNode> prefixNodes;
+    vector<int> wordNode;
+    vector<int> openNodes;
+
+    // Exact selection: outcome, and its dp tables (see chooseWordsExact)
+    int greedyReward = -1; // reward of the greedy selection, once exact ran
+    bool exactTimedOut = false;
+    vector<int> exactPrev;
+    vector<vector<ChainEnd>> exactOpen;
+
+    SearchEngine engineUsed; // the engine that searched the last board
+    vector<string> matchKeys; // reverse search: each word's path as directions
+    vector<int> matchOrder;
+
+    SearchContext search; // serial search, and merging parallel results
+    SearchContext cacheSearch; // searches for cached words (see Result cache)
+    FoundWords found;
+    vector<SearchContext> workerSearch; // parallel search: one per pool worker
+    vector<FoundWords> taskFound; // and one buffer per task
+    vector<pair<int,int>> searchTasks;
+};
+
+// Profiling (-DWORDHUNT_PROFILE)
+// Time spent in each phase and counts of search events, kept per thread and
+// summed for --profile. Without WORDHUNT_PROFILE none of it is compiled.
+#ifdef WORDHUNT_PROFILE
+enum ProfilePhase {
+    loadPhase, inputPhase, boardPhase, searchPhase, choosePhase, exactPhase,
+    orderPhase, printChosenPhase, printAllPhase, statsPhase, recordPhase, phaseCount
+};
+enum ProfileCounter {
+    dfsNodesCounter, trieLookupsCounter, noChildCounter, bigramPrunedCounter,
+    listPrunedCounter, wordsFoundCounter, reverseCandidatesCounter, counterCount
+};
+
+struct PhaseStats {
+    long long calls;
+    long long nanoseconds;
+    long long maxNanoseconds; // longest single call
+};
+
+struct ProfileCounts {
+    PhaseStats phases[phaseCount];
+    long long counters[counterCount];
 };
+#endif
 
 // Stats for vector of words
 struct WordListStats {
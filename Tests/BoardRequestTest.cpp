@@ -0,0 +1,55 @@
+/**
+ * Tests for requests that are not boards
+ *
+ * Interactive, batch and server mode all read a request the same way
+ * (selectDictionary, then parseBoard), so a malformed one, even one that
+ * strips down to nothing like ":" or "name:", must come back as an error
+ * record instead of reaching setBoard. Includes the solver as a library
+ * (its main() is compiled out), like the benchmarks.
+ *
+ * Usage (from the repository root, so the relative dictionary path resolves):
+ * g++ -O2 -pthread Tests/BoardRequestTest.cpp -o BoardRequestTest
+ * ./BoardRequestTest
+ */
+
+#define WORDHUNT_NO_MAIN
+#include "../FinalWordHuntSolver.cpp"
+
+int failures = 0;
+
+void expect(bool ok, const string &what) {
+    if (ok) return;
+    cout << "FAIL: " << what << '\n';
+    failures++;
+}
+
+int main() {
+    // Two named lists, so "name:" requests resolve to a real dictionary
+    dictionaries = {{"main", dictionaryTextPath}, {"other", dictionaryTextPath}};
+    if (!loadDictionaries()) return 1;
+    Solver s;
+    s.trie = &trie;
+
+    const vector<string> invalid = {
+        "", ":", "main:", "other:", "unknown:", "unknown:serpatglinesersabcd",
+        "/", "//", "ab/", "a//b", "abc", "ab1d", "ab/abc",
+        string(81, 'a') // 9x9, more cells than a board can have
+    };
+    for(const string &request : invalid) {
+        BoardResult r = solveBoard(s, request);
+        expect(!r.error.empty(), "\"" + request + "\" is rejected");
+        string record;
+        appendResult(record, r);
+        expect(record.find("\"error\":") != string::npos, "\"" + request + "\" gives an error record");
+    }
+
+    const vector<string> valid = {"serpatglinesersa", "other:serpatglinesersa", "ser/pat/gli", "se.p/atgl"};
+    for(const string &request : valid) {
+        BoardResult r = solveBoard(s, request);
+        expect(r.error.empty(), "\"" + request + "\" is solved (" + r.error + ")");
+        expect(!r.words.empty(), "\"" + request + "\" has words");
+    }
+
+    cout << invalid.size() + valid.size() << " requests, " << failures << " failure(s)" << endl;
+    return failures ? 1 : 0;
+}
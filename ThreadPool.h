@@ -0,0 +1,180 @@
+// Threading helpers: the work-stealing thread pool used by the parallel search,
+// and the bounded queue that connects the stages of batch mode
+// Included from FinalWordHuntSolver.cpp after the standard headers
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+class ThreadPool {
+public:
+    // threads <= 0 uses every core
+    explicit ThreadPool(int threads) {
+        if (threads <= 0) threads = max(1u, thread::hardware_concurrency());
+        queues = vector<WorkQueue>(threads);
+        for(int i = 0; i < threads; i++) {
+            workers.emplace_back([this, i]() { work(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(jobMutex);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for(thread &t : workers) t.join();
+    }
+
+    int size() const {
+        return workers.size();
+    }
+
+    // Runs task(i, worker) for every i in [0, n) and waits for all of them.
+    // Each worker starts on its own contiguous block of indices (in order) and
+    // steals from the back of the other workers' blocks once it runs out.
+    void parallelFor(int n, const function<void(int,int)> &task) {
+        if (n <= 0) return;
+        int w = workers.size();
+        for(int i = 0; i < w; i++) {
+            lock_guard<mutex> lock(queues[i].m);
+            for(int j = (long long) n * i / w; j < (long long) n * (i + 1) / w; j++) {
+                queues[i].tasks.push_back(j);
+            }
+        }
+        {
+            lock_guard<mutex> lock(jobMutex);
+            currentTask = &task;
+            remaining = n;
+            generation++;
+        }
+        jobReady.notify_all();
+
+        // Also wait for every worker that picked up this job to let go of it,
+        // so none of them can run task on the next job's indices
+        unique_lock<mutex> lock(jobMutex);
+        jobDone.wait(lock, [this]() { return remaining == 0 && active == 0; });
+        currentTask = nullptr;
+    }
+
+private:
+    struct WorkQueue {
+        mutex m;
+        deque<int> tasks;
+    };
+
+    vector<thread> workers;
+    vector<WorkQueue> queues;
+
+    mutex jobMutex;
+    condition_variable jobReady, jobDone;
+    const function<void(int,int)> *currentTask = nullptr;
+    int remaining = 0; // indices of the current job not yet run
+    int active = 0; // workers currently holding currentTask
+    long long generation = 0;
+    bool stopping = false;
+
+    // Takes the next index from the worker's own queue, or steals one
+    bool nextTask(int worker, int &task) {
+        {
+            WorkQueue &q = queues[worker];
+            lock_guard<mutex> lock(q.m);
+            if (!q.tasks.empty()) {
+                task = q.tasks.front();
+                q.tasks.pop_front();
+                return true;
+            }
+        }
+        for(int i = 1; i < (int) queues.size(); i++) {
+            WorkQueue &q = queues[(worker + i) % queues.size()];
+            lock_guard<mutex> lock(q.m);
+            if (!q.tasks.empty()) {
+                task = q.tasks.back();
+                q.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(int worker) {
+        long long seen = 0;
+        while(true) {
+            const function<void(int,int)> *task;
+            {
+                unique_lock<mutex> lock(jobMutex);
+                jobReady.wait(lock, [&]() { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                task = currentTask;
+                if (!task) continue;
+                active++;
+            }
+
+            int i, done = 0;
+            while(nextTask(worker, i)) {
+                (*task)(i, worker);
+                done++;
+            }
+            {
+                lock_guard<mutex> lock(jobMutex);
+                remaining -= done;
+                active--;
+                if (remaining == 0 && active == 0) jobDone.notify_all();
+            }
+        }
+    }
+};
+
+// Bounded multi-producer, multi-consumer queue. push blocks while the queue
+// is full (tryPush instead returns false and leaves item alone); pop blocks
+// while it is empty and returns false once it is closed and drained.
+template<class T>
+class BlockingQueue {
+public:
+    explicit BlockingQueue(size_t capacity) : capacity(capacity) {}
+
+    void push(T item) {
+        unique_lock<mutex> lock(m);
+        notFull.wait(lock, [this]() { return items.size() < capacity; });
+        items.push_back(move(item));
+        notEmpty.notify_one();
+    }
+
+    bool tryPush(T &item) {
+        lock_guard<mutex> lock(m);
+        if (items.size() >= capacity) return false;
+        items.push_back(move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(T &item) {
+        unique_lock<mutex> lock(m);
+        notEmpty.wait(lock, [this]() { return !items.empty() || closed; });
+        if (items.empty()) return false;
+        item = move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // No more pushes will follow
+    void close() {
+        lock_guard<mutex> lock(m);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    size_t capacity;
+    deque<T> items;
+    bool closed = false;
+    mutex m;
+    condition_variable notEmpty, notFull;
+};